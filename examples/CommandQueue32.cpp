@@ -0,0 +1,68 @@
+/*
+    ESP32 only. Changes Leds from loop() and from a hardware timer ISR at
+    the same time while one of them pulses, to check on a real board that
+    setters never block and that the last call always wins.
+
+    Every second the sketch prints how many calls each side made, how many
+    ISR calls found their ring full and whether both Leds hold the values
+    last given to them.
+
+*/
+
+
+
+#include <Arduino.h>
+#include "ESPLed.h"
+
+Led pulsing(2, REG);
+Led flashing(4, REG);
+
+hw_timer_t *timer = nullptr;
+volatile uint32_t isrCalls = 0;
+volatile uint8_t isrLast = 0;
+
+// Alternates the second Led from the ISR, it is never animated so these calls are not the task's to make
+void IRAM_ATTR onTimer(){
+    isrLast = (isrCalls & 1) ? 0 : 60;
+    if(isrLast) flashing.on(isrLast);
+    else flashing.off();
+    isrCalls++;
+}
+
+void setup(){
+    Serial.begin(115200);
+
+    pulsing.setPeriod(1000).pulse().start();
+    LedScheduler::getInstance().begin();
+
+    // 10kHz, well past what the scheduler task applies per tick
+    timer = timerBegin(0, 80, true);
+    timerAttachInterrupt(timer, &onTimer, true);
+    timerAlarmWrite(timer, 100, true);
+    timerAlarmEnable(timer);
+}
+
+void loop(){
+    static uint32_t taskCalls = 0;
+    static unsigned long last = 0;
+
+    // The task retimes the pulsing Led as fast as it can
+    pulsing.setPeriod(800 + (taskCalls % 400));
+    taskCalls++;
+
+    if(millis() - last >= 1000) {
+        last = millis();
+
+        // Stop both sides, let the scheduler task catch up and compare
+        timerAlarmDisable(timer);
+        const unsigned long period = 800 + ((taskCalls - 1) % 400);
+        delay(50);
+
+        Serial.printf("task %u calls, isr %u calls, %u dropped, period %s, flashing %s\n",
+            (unsigned)taskCalls, (unsigned)isrCalls, (unsigned)LedScheduler::getInstance().getDropped(),
+            pulsing.getPeriod() == period ? "ok" : "WRONG",
+            flashing.isOn() == (isrLast != 0) ? "ok" : "WRONG");
+
+        timerAlarmEnable(timer);
+    }
+}
@@ -0,0 +1,73 @@
+/*
+    Drives four Leds from a lighting controller over WiFi. Point the
+    controller's Art-Net or E1.31 output at this board, universe 1, and
+    patch four dimmers from DMX address 1.
+
+    Both ports are listened on, whichever protocol the controller sends
+    is parsed straight out of the receive buffer.
+
+*/
+
+
+
+#include <Arduino.h>
+#ifdef ESP32
+#include <WiFi.h>
+#else
+#include <ESP8266WiFi.h>
+#endif
+#include <WiFiUdp.h>
+#include "ESPLed.h"
+#include "LedDmx.h"
+
+#define WIFI_SSID     "ssid"
+#define WIFI_PASS     "password"
+
+#define UNIVERSE      1
+#define ADDRESS       1
+
+const uint8_t pins[4] = { 4, 5, 12, 13 };
+Led leds[4];
+LedGroup group;
+LedDmx dmx(group, UNIVERSE, ADDRESS);
+
+WiFiUDP artnet;
+WiFiUDP e131;
+uint8_t packet[DMX_PACKET_MAX];
+
+// Applies one waiting packet from a socket, if any
+void receive(WiFiUDP &udp) {
+    if(!udp.parsePacket()) return;
+    const int length = udp.read(packet, sizeof(packet));
+    if(length > 0) dmx.receive(packet, length);
+}
+
+void setup(){
+    Serial.begin(115200);
+
+    for(uint8_t i = 0; i < 4; i++) group.add(leds[i].setPin(pins[i]));
+
+    WiFi.mode(WIFI_STA);
+    WiFi.begin(WIFI_SSID, WIFI_PASS);
+    while(WiFi.status() != WL_CONNECTED) delay(100);
+    Serial.println(WiFi.localIP());
+
+    // E1.31 senders multicast each universe to 239.255.<hi>.<lo>
+    artnet.begin(ARTNET_PORT);
+    e131.beginMulticast(
+#ifndef ESP32
+        WiFi.localIP(),
+#endif
+        IPAddress(239, 255, UNIVERSE >> 8, UNIVERSE & 0xFF), E131_PORT);
+}
+
+void loop(){
+    receive(artnet);
+    receive(e131);
+
+    static unsigned long last = 0;
+    if(millis() - last >= 5000) {
+        last = millis();
+        Serial.printf("%u frames, %u out of order\n", (unsigned)dmx.getFrames(), (unsigned)dmx.getOutOfOrder());
+    }
+}
@@ -6,12 +6,13 @@
 // Because LED_BUILTIN is ON when the pin is HIGH, we use INVERTED
 // Default led_style_t parameter is REG
 
-Led led(ESP_BUILTIN,0, REG);
+Led led(ESP_BUILTIN, REG);
 // Pins ESP_BUILTIN and NODEMCU_BUILTIN are provided by Led.h
 
 
-// // For ESP32 an additional Led channel parameter is required
-// // Behavior is currently undefined if you use the same channel on multiple pins
+// // PWM channels are assigned automatically and Leds with the same frequency
+// // share a timer. A channel can still be picked by hand, getChannel()
+// // returns ESPLED_NO_CHANNEL if it is taken or no timer is left
 // Led led(LED_BUILTIN, 0, INVERTED);
 
 
@@ -0,0 +1,352 @@
+/*
+  LedBenchmark.cpp
+
+  Host benchmarks for the brightness and waveform hot paths. Each case is
+  repeated until it has run for at least BENCH_MIN_NS of wall time and is
+  reported in ns and heap allocations per operation.
+
+  Build it like any host program (see Host Builds in README.md) with
+  optimization on, and pass a substring to only run matching cases, ie
+
+    ./bench pulse
+
+  Virtual time only moves when a case advances it. Tick cases advance the
+  clock by one 60Hz refresh per operation, clock_advance measures what
+  that costs on its own.
+
+*/
+
+#include <ESPLed.h>
+#include <PulseBank.h>
+#include <LedDmx.h>
+#include <HostBackend.h>
+
+#include <chrono>
+#include <math.h>
+#include <new>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// Least wall time spent on each case
+#define BENCH_MIN_NS  200000000ULL
+
+// Tick length used by the tick cases
+#define BENCH_TICK_US 16667
+
+
+
+/*
+  Heap allocations are counted by replacing the global operators
+*/
+static unsigned long _allocations = 0;
+
+void *operator new(size_t size) {
+  _allocations++;
+  void *ptr = malloc(size ? size : 1);
+  if(ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+
+// Results are stored here so the optimizer cannot drop the work
+static volatile uint32_t _sink = 0;
+
+ESPLED_BRIGHTNESS_LUT(_lut16, 16, AntilogCurve);
+
+static const char *_filter = nullptr;
+
+
+
+/*
+  Reaches the internals being measured
+*/
+class LedBenchmark {
+public:
+
+  static uint16_t mapToAnalog(Led &led, uint16_t level) { return led._mapToAnalog(level); }
+  static int16_t mapToSine(uint32_t phase) { return Pulse::_mapToSine(phase); }
+  static uint16_t mapToLevel(uint32_t phase) { return Pulse::_mapToLevel(phase, 0, LED_LEVEL_MAX); }
+  static uint64_t handle(Led &led) { return led._strategy->_handle(); }
+};
+
+
+
+/*
+  Runs body(), which performs opsPerCall operations, until enough time has
+  passed and prints the cost of one operation
+*/
+template<typename Body>
+static void run(const char *name, unsigned long opsPerCall, Body body) {
+  if(_filter != nullptr && strstr(name, _filter) == nullptr) return;
+
+  typedef std::chrono::steady_clock clock;
+
+  // Warm up caches and any lazily built tables
+  for(int i = 0; i < 16; i++) body();
+
+  unsigned long long calls = 0;
+  unsigned long long elapsed_ns = 0;
+  const unsigned long allocations = _allocations;
+  const clock::time_point start = clock::now();
+
+  // Batches keep clock reads out of the measurement
+  unsigned long long batch = 1;
+  while(elapsed_ns < BENCH_MIN_NS) {
+    for(unsigned long long i = 0; i < batch; i++) body();
+    calls += batch;
+    batch *= 2;
+    elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+  }
+
+  const double ops = double(calls) * opsPerCall;
+  printf("%-28s %12.2f ns/op %10.3f allocs/op\n", name, elapsed_ns / ops, (_allocations - allocations) / ops);
+}
+
+
+
+/*
+  Brightness and waveform math
+*/
+static void benchMapping() {
+  Led led(4, REG);
+  uint16_t level = 0;
+  run("map_to_analog", 1, [&]() {
+    _sink += LedBenchmark::mapToAnalog(led, level);
+    level = (level + 97) & LED_LEVEL_MAX;
+  });
+
+  led.setBrightnessLut(_lut16);
+  run("map_to_analog/16bit", 1, [&]() {
+    _sink += LedBenchmark::mapToAnalog(led, level);
+    level = (level + 97) & LED_LEVEL_MAX;
+  });
+
+  uint32_t phase = 0;
+  run("map_to_sine", 1, [&]() {
+    _sink += LedBenchmark::mapToSine(phase);
+    phase += 0x01234567;
+  });
+}
+
+
+
+/*
+  Float reference for one pulse step, as Pulse computed it before it moved
+  to a fixed point phase: a quarter wave table of floats indexed from
+  theta in radians, scaled by a float amplitude around the midpoint
+*/
+#define FLOAT_SINE_STEPS 101
+static float _floatSine[FLOAT_SINE_STEPS];
+
+static float floatMapToSine(float theta) {
+  int index = 0;
+  int sign = 1;
+  const int elements = FLOAT_SINE_STEPS - 1;
+
+  if(theta >= 3 * HALF_PI && theta < TWO_PI) {
+    index = -1 * elements;
+    sign = -1;
+  }
+  else if(theta > PI) sign = -1;
+  else if(theta > HALF_PI) index = -1 * elements;
+
+  index = abs(index + int(elements * theta / HALF_PI) % elements);
+  return sign * _floatSine[index];
+}
+
+static uint8_t floatPulseStep(float &theta, float step) {
+  theta += step;
+  if(theta >= TWO_PI) theta = 0;
+
+  const uint8_t offset = (100 + 0) / 2;
+  const uint8_t amplitude = 100 - offset;
+  return amplitude * floatMapToSine(theta) + offset;
+}
+
+/*
+  The pulse waveform alone, fixed point against the float reference
+*/
+static void benchWaveform() {
+  for(int i = 0; i < FLOAT_SINE_STEPS; i++) _floatSine[i] = sin(i * HALF_PI / (FLOAT_SINE_STEPS - 1));
+
+  uint32_t phase = 0;
+  run("pulse_wave/fixed", 1, [&]() {
+    _sink += LedBenchmark::mapToLevel(phase);
+    phase += 0x01234567;
+  });
+
+  float theta = 0;
+  run("pulse_wave/float", 1, [&]() { _sink += floatPulseStep(theta, 0.0731f); });
+}
+
+
+
+/*
+  Single ticks of each strategy, as the scheduler would make them
+*/
+static void benchTicks() {
+  run("clock_advance", 1, [&]() { HostClock::advance(BENCH_TICK_US); });
+
+  Led pulsed(4, REG);
+  pulsed.setPeriod(2000).pulse();
+  run("pulse_handle", 1, [&]() {
+    _sink += LedBenchmark::handle(pulsed);
+    HostClock::advance(BENCH_TICK_US);
+  });
+
+  Led uncached(5, REG);
+  uncached.setPeriod(2000).setMinLevel(1).pulse();
+  Led follower(6, REG);
+  follower.sync(uncached, 0x80000000);
+  run("pulse_handle/synced", 1, [&]() {
+    _sink += LedBenchmark::handle(uncached);
+    HostClock::advance(BENCH_TICK_US);
+  });
+
+  Led blinked(7, REG);
+  blinked.blink();
+  run("blink_handle", 1, [&]() {
+    _sink += LedBenchmark::handle(blinked);
+    HostClock::advance(BENCH_TICK_US);
+  });
+}
+
+
+
+/*
+  Switching strategies, each constructs and destroys one in place
+*/
+static void benchModes() {
+  Led led(4, REG);
+  run("mode_switch", 3, [&]() {
+    led.pulse();
+    led.blink();
+    led.manual();
+  });
+}
+
+
+
+/*
+  Whole frames written to many Leds, one operation is one frame
+*/
+static void benchGroup(unsigned long count, const char *name) {
+  std::vector<Led> leds(count);
+  std::vector<LedGroup> groups((count + ESPLED_GROUP_SIZE - 1) / ESPLED_GROUP_SIZE);
+  for(unsigned long i = 0; i < count; i++) {
+    leds[i].setPin(i % 200).setStyle(REG);
+    groups[i / ESPLED_GROUP_SIZE].add(leds[i]);
+  }
+
+  uint8_t percent = 0;
+  run(name, 1, [&]() {
+    for(size_t g = 0; g < groups.size(); g++) {
+      groups[g].setAll(percent);
+      _sink += groups[g].flush();
+    }
+    percent = (percent + 7) % 101;
+  });
+}
+
+template<uint16_t Size>
+static void benchBank(const char *name) {
+  static PulseBank<Size> bank;
+  for(uint16_t i = 0; i < Size; i++) bank.add(500 + (i * 37) % 3000, 0, LED_LEVEL_MAX, i * 8388608UL);
+
+  run(name, 1, [&]() {
+    bank.step();
+    _sink += bank.getLevel(0);
+  });
+}
+
+
+
+/*
+  Network DMX frames onto a full group, one operation is one packet
+*/
+static void fillArtnet(uint8_t *packet, uint16_t count) {
+  static const uint8_t header[ARTNET_HEADER_SIZE] = {
+    'A', 'r', 't', '-', 'N', 'e', 't', 0, 0x00, 0x50, 0, 14, 0, 0, 0, 0, uint8_t(count >> 8), uint8_t(count)
+  };
+  memcpy(packet, header, sizeof(header));
+}
+
+static void fillE131(uint8_t *packet, uint16_t count) {
+  static const uint8_t id[12] = { 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0 };
+  memset(packet, 0, E131_HEADER_SIZE);
+  packet[1] = 0x10;
+  memcpy(packet + 4, id, sizeof(id));
+  packet[21] = 0x04;
+  packet[43] = 0x02;
+  packet[108] = 100;
+  packet[114] = 1;
+  packet[117] = 0x02;
+  packet[118] = 0xA1;
+  packet[122] = 1;
+  packet[123] = (count + 1) >> 8;
+  packet[124] = (count + 1) & 0xFF;
+}
+
+static void benchDmx() {
+  static uint8_t artnet[ARTNET_HEADER_SIZE + DMX_SLOTS];
+  static uint8_t e131[DMX_PACKET_MAX];
+  fillArtnet(artnet, DMX_SLOTS);
+  fillE131(e131, DMX_SLOTS);
+
+  DmxFrame frame;
+  run("dmx_parse/artnet", 1, [&]() { _sink += LedDmx::parse(artnet, sizeof(artnet), frame); });
+  run("dmx_parse/e131", 1, [&]() { _sink += LedDmx::parse(e131, sizeof(e131), frame); });
+
+  std::vector<Led> leds(ESPLED_GROUP_SIZE);
+  LedGroup group;
+  for(uint16_t i = 0; i < ESPLED_GROUP_SIZE; i++) {
+    leds[i].setPin(i).setStyle(REG);
+    group.add(leds[i]);
+  }
+
+  // Same frame every time, only the parse and slot compare remain
+  LedDmx artnetDmx(group, 0, 1);
+  run("dmx_receive/unchanged", 1, [&]() { _sink += artnetDmx.receive(artnet, sizeof(artnet)); });
+
+  // Every patched slot changes and the sequence advances each frame
+  LedDmx e131Dmx(group, 1, 1);
+  uint8_t step = 0;
+  run("dmx_receive/changed", 1, [&]() {
+    step++;
+    e131[111] = step;
+    for(uint16_t i = 0; i < ESPLED_GROUP_SIZE; i++) e131[E131_HEADER_SIZE + i] = step + i * 16;
+    _sink += e131Dmx.receive(e131, sizeof(e131));
+  });
+}
+
+
+
+int main(int argc, char **argv) {
+  if(argc > 1) _filter = argv[1];
+
+  // Keep the PWM log from growing, pin values are still tracked
+  HostPwm::setRecording(false);
+
+  benchMapping();
+  benchWaveform();
+  benchTicks();
+  benchModes();
+
+  benchGroup(1, "group_update/1");
+  benchGroup(100, "group_update/100");
+  benchGroup(10000, "group_update/10000");
+
+  benchBank<1>("bank_step/1");
+  benchBank<100>("bank_step/100");
+  benchBank<10000>("bank_step/10000");
+
+  benchDmx();
+
+  return 0;
+}
@@ -0,0 +1,105 @@
+/*
+  Arduino.h (host)
+
+  Minimal stand-in for the Arduino core so ESPLed can be built and run on
+  a desktop machine. Time comes from the virtual clock in HostBackend.h,
+  and every PWM write is recorded instead of touching hardware.
+
+  The ESP8266 flavour of the core is emulated by default. Defining ESP32
+  builds the ESP32 paths instead, with FreeRTOS and esp_timer emulated on
+  a single thread (see HostRtos.h) and LEDC writes recorded by channel.
+
+*/
+
+#ifndef ESPLED_HOST_ARDUINO_H
+#define ESPLED_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <stdio.h>
+
+#ifdef ESP32
+#include "HostRtos.h"
+#define log_e(format, ...) printf("[E] " format "\n", ##__VA_ARGS__)
+#endif
+
+#define ESPLED_HOST 1
+
+#define HIGH  0x1
+#define LOW   0x0
+
+#define INPUT   0x00
+#define OUTPUT  0x01
+
+#define PI      3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI  6.283185307179586476925286766559
+
+#define D0  16
+
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+// Program memory is ordinary memory on the host
+#define PROGMEM
+#define pgm_read_byte(addr)       (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)       (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr)      (*(const uint32_t *)(addr))
+#define pgm_read_float_near(addr) (*(const float *)(addr))
+#define pgm_read_ptr(addr)        (*(void * const *)(addr))
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+
+// Timing, driven by the virtual clock
+unsigned long millis();
+unsigned long micros();
+uint64_t micros64();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// GPIO and PWM, recorded by the host backend
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+void analogWrite(uint8_t pin, int val);
+void analogWriteRange(uint32_t range);
+void analogWriteFreq(uint32_t freq);
+
+
+
+/*
+  Print sink writing to stdout
+*/
+class Print {
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t c);
+  size_t write(const char *str);
+
+  size_t print(const char *str) { return write(str); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int n) { return print((long)n); }
+  size_t print(unsigned int n) { return print((unsigned long)n); }
+  size_t print(long n);
+  size_t print(unsigned long n);
+  size_t print(double n, int digits = 2);
+
+  size_t println() { return write("\r\n"); }
+  template<typename T> size_t println(T value) { return print(value) + println(); }
+  size_t println(double n, int digits) { return print(n, digits) + println(); }
+};
+
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long) { }
+};
+
+extern HardwareSerial Serial;
+
+#endif
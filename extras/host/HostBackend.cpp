@@ -0,0 +1,309 @@
+#include "HostBackend.h"
+#include <Ticker.h>
+#include <stdio.h>
+#include <algorithm>
+
+
+static uint64_t _now_us = 0;
+static std::vector<Ticker*> _tickers;
+
+static std::vector<PwmWrite> _writes;
+static uint16_t _pinValues[256];
+static size_t _pinCounts[256];
+static bool _recording = true;
+
+static std::vector<FadeCall> _fades;
+static bool _fadeAvailable = false;
+static bool _fadeFailing = false;
+
+static std::vector<BlinkCall> _blinks;
+static uint32_t _blinkClock_hz = 0;
+static uint8_t _blinkBits = 0;
+
+HardwareSerial Serial;
+
+
+
+/*
+  Virtual clock
+*/
+uint64_t HostClock::now() {
+  return _now_us;
+}
+
+void HostClock::advance(uint64_t us) {
+  advanceTo(_now_us + us);
+}
+
+void HostClock::advanceTo(uint64_t us) {
+#ifdef ESP32
+  // Tasks woken by the program catch up before time passes
+  HostRtos::runReady();
+#endif
+
+  Ticker *ticker;
+  while((ticker = _nextDue(us)) != nullptr) {
+    if(ticker->_deadline_us > _now_us) _now_us = ticker->_deadline_us;
+    ticker->_fire();
+#ifdef ESP32
+    HostRtos::runReady();
+#endif
+  }
+  if(us > _now_us) _now_us = us;
+}
+
+void HostClock::reset() {
+  _now_us = 0;
+  for(Ticker *ticker : _tickers) ticker->detach();
+}
+
+void HostClock::_attach(Ticker *ticker) {
+  _tickers.push_back(ticker);
+}
+
+void HostClock::_detach(Ticker *ticker) {
+  _tickers.erase(std::remove(_tickers.begin(), _tickers.end(), ticker), _tickers.end());
+}
+
+Ticker *HostClock::_nextDue(uint64_t limit) {
+  Ticker *ret = nullptr;
+  for(Ticker *ticker : _tickers) {
+    if(!ticker->_armed || ticker->_deadline_us > limit) continue;
+    if(ret == nullptr || ticker->_deadline_us < ret->_deadline_us) ret = ticker;
+  }
+  return ret;
+}
+
+
+
+/*
+  Ticker
+*/
+Ticker::Ticker() {
+  HostClock::_attach(this);
+}
+
+Ticker::~Ticker() {
+  HostClock::_detach(this);
+}
+
+void Ticker::_armUs(uint64_t us, bool repeat, callback_with_arg_t callback, void *arg, bool hasArg) {
+  _period_us = us;
+  _deadline_us = HostClock::now() + _period_us;
+  _repeat = repeat;
+  _callback = callback;
+  _arg = arg;
+  _hasArg = hasArg;
+  _armed = true;
+}
+
+void Ticker::_fire() {
+  if(_repeat) _deadline_us += (_period_us > 0) ? _period_us : 1;
+  else _armed = false;
+
+  if(_hasArg) _callback(_arg);
+  else ((callback_t)_callback)();
+}
+
+
+
+/*
+  PWM recorder
+*/
+const std::vector<PwmWrite> &HostPwm::writes() {
+  return _writes;
+}
+
+uint16_t HostPwm::value(uint8_t pin) {
+  return _pinValues[pin];
+}
+
+size_t HostPwm::count(uint8_t pin) {
+  return _pinCounts[pin];
+}
+
+void HostPwm::clear() {
+  _writes.clear();
+  memset(_pinValues, 0, sizeof(_pinValues));
+  memset(_pinCounts, 0, sizeof(_pinCounts));
+}
+
+void HostPwm::setRecording(bool enabled) {
+  _recording = enabled;
+}
+
+void HostPwm::_record(uint8_t pin, uint16_t value) {
+  _pinValues[pin] = value;
+  _pinCounts[pin]++;
+  if(_recording) _writes.push_back({ HostClock::now(), pin, value });
+}
+
+
+
+/*
+  LEDC channels and timers
+  Only the bookkeeping in LedcAllocator is exercised on the host, duties
+  written in ESP32 builds are recorded against their channel
+*/
+bool LedBackend::setupTimer(uint8_t, uint8_t, uint32_t, uint8_t) { return true; }
+bool LedBackend::bindTimer(uint8_t, uint8_t) { return true; }
+bool LedBackend::attach(uint8_t, uint8_t) { return true; }
+
+void LedBackend::write(uint8_t channel, uint32_t duty, uint8_t) {
+#ifdef ESP32
+  if(HostRtos::_inIsr) HostRtos::_violation("LEDC write");
+#endif
+  HostPwm::_record(channel, (uint16_t)duty);
+}
+
+
+
+/*
+  Fade unit
+*/
+const std::vector<FadeCall> &HostFade::calls() {
+  return _fades;
+}
+
+void HostFade::clear() {
+  _fades.clear();
+}
+
+void HostFade::setAvailable(bool available) {
+  _fadeAvailable = available;
+}
+
+void HostFade::setFailing(bool failing) {
+  _fadeFailing = failing;
+}
+
+bool LedBackend::hasFade() {
+  return _fadeAvailable;
+}
+
+bool LedBackend::fade(uint8_t channel, uint32_t target, uint32_t time_ms) {
+  if(!_fadeAvailable || _fadeFailing) return false;
+  _fades.push_back({ HostClock::now(), channel, target, time_ms, false });
+  return true;
+}
+
+void LedBackend::stopFade(uint8_t channel) {
+  if(!_fadeAvailable) return;
+  _fades.push_back({ HostClock::now(), channel, 0, 0, true });
+}
+
+
+
+/*
+  Hardware blink
+*/
+const std::vector<BlinkCall> &HostBlink::calls() {
+  return _blinks;
+}
+
+void HostBlink::clear() {
+  _blinks.clear();
+}
+
+void HostBlink::setLimits(uint32_t clock_hz, uint8_t maxBits) {
+  _blinkClock_hz = clock_hz;
+  _blinkBits = maxBits;
+}
+
+bool LedBackend::blinkLimits(uint32_t &clock_hz, uint8_t &maxBits) {
+  if(_blinkClock_hz == 0) return false;
+  clock_hz = _blinkClock_hz;
+  maxBits = _blinkBits;
+  return true;
+}
+
+bool LedBackend::blink(uint8_t channel, const PwmBlink &config) {
+  if(_blinkClock_hz == 0) return false;
+  _blinks.push_back({ HostClock::now(), channel, config });
+  return true;
+}
+
+
+/*
+  Mock I2C bus
+*/
+void HostWire::beginTransmission(uint8_t address) {
+  _address = address;
+  _current.clear();
+}
+
+size_t HostWire::write(uint8_t data) {
+  _current.push_back(data);
+  return 1;
+}
+
+size_t HostWire::write(const uint8_t *data, size_t length) {
+  _current.insert(_current.end(), data, data + length);
+  return length;
+}
+
+uint8_t HostWire::endTransmission() {
+  if(_nack) return 2;
+  _transactions++;
+  _bytes += _current.size();
+  _last.swap(_current);
+  _current.clear();
+  return 0;
+}
+
+void HostWire::clear() {
+  _current.clear();
+  _last.clear();
+  _transactions = 0;
+  _bytes = 0;
+}
+
+
+/*
+  Arduino core functions
+*/
+unsigned long millis() { return (unsigned long)(_now_us / 1000); }
+unsigned long micros() { return (unsigned long)_now_us; }
+uint64_t micros64() { return _now_us; }
+void delay(unsigned long ms) { HostClock::advanceMs(ms); }
+void delayMicroseconds(unsigned int us) { HostClock::advance(us); }
+void yield() { }
+
+void pinMode(uint8_t, uint8_t) { }
+void digitalWrite(uint8_t pin, uint8_t val) { HostPwm::_record(pin, val ? 1023 : 0); }
+void analogWrite(uint8_t pin, int val) { HostPwm::_record(pin, (uint16_t)val); }
+void analogWriteRange(uint32_t) { }
+void analogWriteFreq(uint32_t) { }
+
+
+
+/*
+  Print
+*/
+size_t Print::write(uint8_t c) {
+  return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+size_t Print::write(const char *str) {
+  size_t n = 0;
+  while(*str) n += write((uint8_t)*str++);
+  return n;
+}
+
+size_t Print::print(long n) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%ld", n);
+  return write(buf);
+}
+
+size_t Print::print(unsigned long n) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%lu", n);
+  return write(buf);
+}
+
+size_t Print::print(double n, int digits) {
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return write(buf);
+}
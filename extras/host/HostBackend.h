@@ -0,0 +1,185 @@
+/*
+  HostBackend.h
+
+  Virtual clock and PWM recorder used by the host build of ESPLed.
+
+  Build a host program by putting extras/host ahead of src on the include
+  path and compiling every .cpp file in src and extras/host along with it
+
+  Time never passes on its own. HostClock::advance() moves the clock
+  forward, firing every Ticker that comes due in deadline order, so hours
+  of simulated time take only as long as the handlers themselves. In
+  ESP32 builds esp_timers fire the same way, and tasks they wake run
+  before the clock moves on.
+
+*/
+
+#ifndef ESPLED_HOST_BACKEND_H
+#define ESPLED_HOST_BACKEND_H
+
+#include <Arduino.h>
+#include <LedBackend.h>
+#include <vector>
+
+class Ticker;
+
+class HostClock {
+public:
+
+  // Returns the virtual time in us since reset()
+  static uint64_t now();
+
+  // Moves the clock forward, firing due Tickers along the way
+  static void advance(uint64_t us);
+  static void advanceMs(uint64_t ms) { advance(ms * 1000); }
+
+  // Moves the clock to an absolute time, no effect if it has passed
+  static void advanceTo(uint64_t us);
+
+  // Rewinds the clock to zero and disarms every Ticker
+  static void reset();
+
+protected:
+  friend class Ticker;
+
+  static void _attach(Ticker *ticker);
+  static void _detach(Ticker *ticker);
+
+  // Returns the armed Ticker with the earliest deadline at or before limit
+  static Ticker *_nextDue(uint64_t limit);
+};
+
+
+
+/*
+  Record of every PWM write made through analogWrite(), or through
+  LedBackend::write() in ESP32 builds where pin is the LEDC channel
+*/
+struct PwmWrite {
+  uint64_t time_us;   // Virtual time of the write
+  uint8_t pin;        // Gpio pin, LEDC channel on ESP32
+  uint16_t value;     // Duty written
+};
+
+class HostPwm {
+public:
+
+  // Every write since the last clear(), oldest first
+  static const std::vector<PwmWrite> &writes();
+
+  // Returns the last value written to a pin, 0 if never written
+  static uint16_t value(uint8_t pin);
+
+  // Returns the number of writes made to a pin
+  static size_t count(uint8_t pin);
+
+  // Forgets recorded writes and pin values
+  static void clear();
+
+  // Turns recording of individual writes on or off
+  // Pin values are tracked either way
+  static void setRecording(bool enabled);
+
+protected:
+  friend void analogWrite(uint8_t, int);
+  friend void digitalWrite(uint8_t, uint8_t);
+  friend class LedBackend;
+  static void _record(uint8_t pin, uint16_t value);
+};
+
+
+
+/*
+  Stand in for a PWM fade unit, every LedBackend fade call is recorded
+*/
+struct FadeCall {
+  uint64_t time_us;   // Virtual time of the call
+  uint8_t channel;    // Channel / pin faded
+  uint32_t target;    // Duty at the end of the fade, 0 for stopFade()
+  uint32_t time_ms;   // Length of the fade
+  bool stop;          // True for stopFade()
+};
+
+class HostFade {
+public:
+
+  // Every call since the last clear(), oldest first
+  static const std::vector<FadeCall> &calls();
+
+  // Forgets recorded calls
+  static void clear();
+
+  // Sets whether LedBackend reports a fade unit, off by default like ESP8266
+  static void setAvailable(bool available);
+
+  // Makes fade() fail, to exercise the software fallback
+  static void setFailing(bool failing);
+};
+
+
+
+/*
+  Stand in for a PWM unit that can blink on its own
+*/
+struct BlinkCall {
+  uint64_t time_us;   // Virtual time of the call
+  uint8_t channel;    // Channel / pin programmed
+  PwmBlink config;    // Timer settings
+};
+
+class HostBlink {
+public:
+
+  // Every LedBackend::blink() since the last clear(), oldest first
+  static const std::vector<BlinkCall> &calls();
+
+  // Forgets recorded calls
+  static void clear();
+
+  // Sets the timer clock and resolution LedBackend reports
+  // A clock of 0 reports no hardware blink, the default like ESP8266
+  static void setLimits(uint32_t clock_hz, uint8_t maxBits);
+};
+
+
+
+/*
+  Stand in for TwoWire, records every transaction sent to it
+*/
+class HostWire {
+public:
+
+  void beginTransmission(uint8_t address);
+  size_t write(uint8_t data);
+  size_t write(const uint8_t *data, size_t length);
+
+  // Ends the transaction, returns 2 (address NACK) if setNack() is set
+  uint8_t endTransmission();
+
+  // Returns the number of transactions since the last clear()
+  size_t transactions() { return _transactions; }
+
+  // Returns the number of bytes written since the last clear(), addresses excluded
+  size_t bytes() { return _bytes; }
+
+  // Returns the address / bytes of the last transaction
+  uint8_t address() { return _address; }
+  const std::vector<uint8_t> &last() { return _last; }
+
+  // Makes every transaction fail like an absent device
+  void setNack(bool nack) { _nack = nack; }
+
+  // Forgets recorded transactions
+  void clear();
+
+protected:
+
+  std::vector<uint8_t> _current;
+  std::vector<uint8_t> _last;
+  size_t _transactions = 0;
+  size_t _bytes = 0;
+  uint8_t _address = 0;
+  bool _nack = false;
+};
+
+#endif
@@ -0,0 +1,217 @@
+#ifdef ESP32
+
+#include "HostRtos.h"
+#include "HostBackend.h"
+#include <Ticker.h>
+#include <esp_timer.h>
+#include <ucontext.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Host stacks are far larger than the depth asked for, printf alone needs more
+#define HOST_TASK_STACK   (256 * 1024)
+
+struct HostTask {
+  ucontext_t context;
+  TaskFunction_t function;
+  void *param;
+  char *stack;
+  uint32_t notified;
+  bool blocked;
+};
+
+struct HostMutex {
+  TaskHandle_t holder;
+  uint32_t depth;
+};
+
+static HostTask _loopTask = {};
+static TaskHandle_t _current = &_loopTask;
+static std::vector<HostTask*> _tasks;
+static uint32_t _switches = 0;
+static uint32_t _violations = 0;
+
+bool HostRtos::_inIsr = false;
+
+
+
+/*
+  Tasks
+  A task runs from the loop task's context and swaps back when it blocks
+*/
+static void _taskEntry(int hi, int lo) {
+  HostTask *task = (HostTask *)((uintptr_t(uint32_t(hi)) << 16 << 16) | uintptr_t(uint32_t(lo)));
+  task->function(task->param);
+
+  // FreeRTOS tasks must not return
+  fprintf(stderr, "HostRtos: task returned\n");
+  abort();
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *, uint32_t, void *param, UBaseType_t, TaskHandle_t *handle) {
+  HostTask *task = new HostTask();
+  task->function = function;
+  task->param = param;
+  task->stack = (char *)malloc(HOST_TASK_STACK);
+
+  getcontext(&task->context);
+  task->context.uc_stack.ss_sp = task->stack;
+  task->context.uc_stack.ss_size = HOST_TASK_STACK;
+  task->context.uc_link = nullptr;
+  const uintptr_t ptr = uintptr_t(task);
+  makecontext(&task->context, (void (*)())_taskEntry, 2, int(uint32_t(ptr >> 16 >> 16)), int(uint32_t(ptr)));
+
+  _tasks.push_back(task);
+  if(handle != nullptr) *handle = task;
+  return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return _current;
+}
+
+BaseType_t xTaskGetSchedulerState() {
+  return taskSCHEDULER_RUNNING;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  task->notified++;
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) {
+  task->notified++;
+  if(woken != nullptr) *woken = pdFALSE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait) {
+  HostTask *self = _current;
+
+  if(self->notified == 0 && wait != 0) {
+    if(self == &_loopTask) {
+      // Nothing else can run to notify the program
+      fprintf(stderr, "HostRtos: loop task would block forever\n");
+      abort();
+    }
+    self->blocked = true;
+    swapcontext(&self->context, &_loopTask.context);
+  }
+
+  const uint32_t count = self->notified;
+  if(clear) self->notified = 0;
+  else if(count > 0) self->notified--;
+  return count;
+}
+
+void HostRtos::runReady() {
+  if(_current != &_loopTask) return;
+
+  bool ran = true;
+  while(ran) {
+    ran = false;
+    for(size_t i = 0; i < _tasks.size(); i++) {
+      HostTask *task = _tasks[i];
+      if(task->blocked && task->notified == 0) continue;
+
+      task->blocked = false;
+      _current = task;
+      _switches++;
+      swapcontext(&_loopTask.context, &task->context);
+      _current = &_loopTask;
+      ran = true;
+    }
+  }
+}
+
+uint32_t HostRtos::switches() {
+  return _switches;
+}
+
+
+
+/*
+  Recursive mutexes
+*/
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+  return new HostMutex();
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t) {
+  if(HostRtos::_inIsr) HostRtos::_violation("lock taken");
+
+  if(mutex->holder != nullptr && mutex->holder != _current) {
+    // Tasks only switch while blocked on a notification, never inside a lock
+    fprintf(stderr, "HostRtos: lock held across a task switch\n");
+    abort();
+  }
+  mutex->holder = _current;
+  mutex->depth++;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex) {
+  if(mutex->holder != _current || mutex->depth == 0) return pdFALSE;
+  if(--mutex->depth == 0) mutex->holder = nullptr;
+  return pdTRUE;
+}
+
+TaskHandle_t xSemaphoreGetMutexHolder(SemaphoreHandle_t mutex) {
+  return mutex->holder;
+}
+
+
+
+/*
+  ISR context
+*/
+BaseType_t xPortInIsrContext() {
+  return HostRtos::_inIsr;
+}
+
+uint32_t HostRtos::isrViolations() {
+  return _violations;
+}
+
+void HostRtos::_violation(const char *what) {
+  _violations++;
+  fprintf(stderr, "HostRtos: %s in ISR context\n", what);
+}
+
+
+
+/*
+  esp_timer, a Ticker armed in us
+*/
+struct esp_timer : public Ticker {
+  esp_timer_cb_t callback;
+  void *arg;
+
+  void startOnce(uint64_t us) { _armUs(us, false, callback, arg, true); }
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle) {
+  esp_timer *timer = new esp_timer();
+  timer->callback = args->callback;
+  timer->arg = args->arg;
+  *handle = timer;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+  if(timer->active()) return ESP_ERR_INVALID_STATE;
+  timer->startOnce(timeout_us);
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  if(!timer->active()) return ESP_ERR_INVALID_STATE;
+  timer->detach();
+  return ESP_OK;
+}
+
+int64_t esp_timer_get_time() {
+  return (int64_t)HostClock::now();
+}
+
+#endif
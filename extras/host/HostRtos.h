@@ -0,0 +1,103 @@
+/*
+  HostRtos.h
+
+  Single threaded stand-in for the parts of FreeRTOS that ESPLed uses on
+  ESP32, included by the host Arduino.h when ESP32 is defined.
+
+  Tasks are coroutines on their own stacks. They never preempt the
+  program, a task made ready by a notification runs when the program
+  hands over time, ie inside HostClock::advance() or delay(), and runs
+  until it blocks again. The program itself is the loop task. Since no
+  switch can happen while a lock is held, a contended lock is a bug in
+  the code under test and aborts.
+
+  HostRtos::isr() runs code as an ISR would. Taking a lock or writing a
+  LEDC channel from there is counted as a violation rather than hanging.
+
+*/
+
+#ifndef ESPLED_HOST_RTOS_H
+#define ESPLED_HOST_RTOS_H
+
+#include <stdint.h>
+
+struct HostTask;
+struct HostMutex;
+
+typedef HostTask *TaskHandle_t;
+typedef HostMutex *SemaphoreHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdFALSE   0
+#define pdTRUE    1
+#define pdPASS    1
+#define pdFAIL    0
+
+#define portMAX_DELAY       0xFFFFFFFF
+#define portTICK_PERIOD_MS  1
+
+#define taskSCHEDULER_SUSPENDED    0
+#define taskSCHEDULER_NOT_STARTED  1
+#define taskSCHEDULER_RUNNING      2
+
+// Tasks and notifications
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stackDepth, void *param, UBaseType_t priority, TaskHandle_t *handle);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+BaseType_t xTaskGetSchedulerState();
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+
+// Recursive mutexes
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex();
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t wait);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex);
+TaskHandle_t xSemaphoreGetMutexHolder(SemaphoreHandle_t mutex);
+
+// Critical sections, nothing can interrupt the single thread
+typedef struct { uint32_t owner; uint32_t count; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { 0, 0 }
+#define portENTER_CRITICAL(mux)       ((void)(mux))
+#define portEXIT_CRITICAL(mux)        ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux)   ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux)    ((void)(mux))
+
+BaseType_t xPortInIsrContext();
+
+#define IRAM_ATTR
+
+
+
+class HostRtos {
+public:
+
+  // Runs code in ISR context
+  template<typename F>
+  static void isr(F body) {
+    _inIsr = true;
+    body();
+    _inIsr = false;
+  }
+
+  // Runs every ready task until each blocks, HostClock does this as time passes
+  static void runReady();
+
+  // Returns the number of times a task was switched in
+  static uint32_t switches();
+
+  // Returns the number of locks taken and LEDC writes made in ISR context
+  static uint32_t isrViolations();
+
+protected:
+  friend BaseType_t xPortInIsrContext();
+  friend BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t, TickType_t);
+  friend class LedBackend;
+
+  static bool _inIsr;
+  static void _violation(const char *what);
+};
+
+#endif
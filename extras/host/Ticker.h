@@ -0,0 +1,56 @@
+/*
+  Ticker.h (host)
+
+  Ticker that fires from the virtual clock in HostBackend.h instead of an
+  SDK timer. Callbacks run inside HostClock::advance() and delay().
+
+*/
+
+#ifndef ESPLED_HOST_TICKER_H
+#define ESPLED_HOST_TICKER_H
+
+#include <Arduino.h>
+
+class Ticker {
+public:
+  typedef void (*callback_t)(void);
+  typedef void (*callback_with_arg_t)(void*);
+
+  Ticker();
+  ~Ticker();
+
+  void attach_ms(uint32_t ms, callback_t callback) { _arm(ms, true, (callback_with_arg_t)callback, nullptr, false); }
+  void once_ms(uint32_t ms, callback_t callback) { _arm(ms, false, (callback_with_arg_t)callback, nullptr, false); }
+
+  template<typename TArg>
+  void attach_ms(uint32_t ms, void (*callback)(TArg), TArg arg) {
+    static_assert(sizeof(TArg) <= sizeof(void*), "attach_ms() callback argument size must be <= sizeof(void*)");
+    _arm(ms, true, (callback_with_arg_t)callback, (void*)arg, true);
+  }
+
+  template<typename TArg>
+  void once_ms(uint32_t ms, void (*callback)(TArg), TArg arg) {
+    static_assert(sizeof(TArg) <= sizeof(void*), "once_ms() callback argument size must be <= sizeof(void*)");
+    _arm(ms, false, (callback_with_arg_t)callback, (void*)arg, true);
+  }
+
+  void detach() { _armed = false; }
+  bool active() { return _armed; }
+
+protected:
+  friend class HostClock;
+
+  void _arm(uint32_t ms, bool repeat, callback_with_arg_t callback, void *arg, bool hasArg) { _armUs(uint64_t(ms) * 1000, repeat, callback, arg, hasArg); }
+  void _armUs(uint64_t us, bool repeat, callback_with_arg_t callback, void *arg, bool hasArg);
+  void _fire();
+
+  bool _armed = false;
+  bool _repeat = false;
+  bool _hasArg = false;
+  uint64_t _period_us = 0;
+  uint64_t _deadline_us = 0;
+  callback_with_arg_t _callback = nullptr;
+  void *_arg = nullptr;
+};
+
+#endif
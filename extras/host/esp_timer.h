@@ -0,0 +1,40 @@
+/*
+  esp_timer.h (host)
+
+  One shot esp_timer for the ESP32 flavour of the host build. Timers fire
+  from the virtual clock in HostBackend.h like Tickers, in deadline order,
+  and esp_timer_get_time() reads that clock.
+
+*/
+
+#ifndef ESPLED_HOST_ESP_TIMER_H
+#define ESPLED_HOST_ESP_TIMER_H
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK                 0
+#define ESP_FAIL               -1
+#define ESP_ERR_INVALID_STATE  0x103
+
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef enum {
+  ESP_TIMER_TASK
+} esp_timer_dispatch_t;
+
+typedef struct {
+  esp_timer_cb_t callback;
+  void *arg;
+  esp_timer_dispatch_t dispatch_method;
+  const char *name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+int64_t esp_timer_get_time();
+
+#endif
@@ -0,0 +1,17 @@
+/*
+  soc/soc_caps.h (host)
+
+  LEDC capabilities of the original ESP32, for the ESP32 flavour of the
+  host build.
+
+*/
+
+#ifndef ESPLED_HOST_SOC_CAPS_H
+#define ESPLED_HOST_SOC_CAPS_H
+
+#define SOC_LEDC_SUPPORT_HS_MODE      1
+#define SOC_LEDC_CHANNEL_NUM          8
+#define SOC_LEDC_SUPPORT_REF_TICK     1
+#define SOC_LEDC_TIMER_BIT_WIDE_NUM   20
+
+#endif
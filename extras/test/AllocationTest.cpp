@@ -0,0 +1,95 @@
+/*
+  AllocationTest.cpp
+
+  Checks that switching a Led between modes and animating it never touches
+  the heap. Allocations are counted by replacing the global operators, the
+  same way the benchmark does.
+
+*/
+
+#include <ESPLed.h>
+#include <HostBackend.h>
+#include <new>
+#include <stdlib.h>
+#include "HostTest.h"
+
+static unsigned long _allocations = 0;
+
+void *operator new(size_t size) {
+  _allocations++;
+  void *ptr = malloc(size ? size : 1);
+  if(ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+
+static const Keyframe _ramp[] = {
+  {   0,   0, EASE_IN_OUT },
+  { 500, 100, EASE_IN_OUT },
+  {1000,   0, EASE_STEP }
+};
+
+static const uint8_t _pattern[] PROGMEM = {
+  SEQ_REPEAT(2), SEQ_ON, SEQ_WAIT(100), SEQ_OFF, SEQ_WAIT(100), SEQ_NEXT,
+  SEQ_LOOP
+};
+
+// Runs every mode on both Leds for a while
+static void cycle(Led &led, Led &follower, KeyframeTable &table, LedSamples &samples) {
+  led.pulse().start();
+  HostClock::advanceMs(100);
+  led.blink().start();
+  HostClock::advanceMs(100);
+  led.keyframes(table).start();
+  HostClock::advanceMs(100);
+  led.sequence(_pattern).start();
+  HostClock::advanceMs(100);
+  samples.push(LED_LEVEL_MAX / 2);
+  led.stream(samples).start();
+  HostClock::advanceMs(100);
+
+  led.pulse().start();
+  follower.sync(led, 0x80000000);
+  HostClock::advanceMs(100);
+  follower.manual();
+
+  led.on(50, 50);
+  HostClock::advanceMs(100);
+  led.setTransition(50).blink().start();
+  HostClock::advanceMs(100);
+  led.setTransition(0).manual();
+  led.off();
+}
+
+int main() {
+  // Keep the PWM log from growing, pin values are still tracked
+  HostPwm::setRecording(false);
+
+  Led led(4, REG);
+  Led follower(5, REG);
+  KeyframeTable table(_ramp, 3);
+  LedSamples samples;
+
+  // First pass may set up host timers and other lazily built state
+  cycle(led, follower, table, samples);
+
+  const unsigned long before = _allocations;
+  for(int i = 0; i < 100; i++) cycle(led, follower, table, samples);
+  CHECK_EQ(_allocations - before, 0);
+
+  // Constructing and destroying Leds does not allocate either
+  const unsigned long constructed = _allocations;
+  for(int i = 0; i < 100; i++) {
+    Led temporary(6, REG);
+    temporary.pulse().start();
+    HostClock::advanceMs(20);
+  }
+  CHECK_EQ(_allocations - constructed, 0);
+
+  return testResult("AllocationTest");
+}
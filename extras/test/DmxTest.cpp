@@ -0,0 +1,277 @@
+/*
+  DmxTest.cpp
+
+  Feeds canned Art-Net and E1.31 packets to a LedDmx and checks which are
+  applied, which are turned away and what reaches each member's pin. No
+  socket is involved, packets are built in memory as a receive buffer
+  would hold them.
+
+  Ends by timing receive() on full universes and prints frames per second,
+  first from memory, then through a UDP socket on the loopback interface.
+
+*/
+
+#include <ESPLed.h>
+#include <LedDmx.h>
+#include <HostBackend.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+#include "HostTest.h"
+
+#define MEMBERS       8
+#define FIRST_PIN     10
+#define REF_PIN       6
+
+static Led ref(REF_PIN, REG);
+
+// Returns the duty a member writes for a slot value
+static uint16_t dutyOf(uint8_t slot) {
+  ref.onLevel((uint32_t(slot) * LED_LEVEL_MAX + 127) / 255);
+  return HostPwm::value(REF_PIN);
+}
+
+// Builds an ArtDmx packet, returns its length
+static size_t artnet(uint8_t *packet, uint16_t universe, uint8_t sequence, const uint8_t *slots, uint16_t count) {
+  static const uint8_t id[8] = { 'A', 'r', 't', '-', 'N', 'e', 't', 0 };
+  memset(packet, 0, ARTNET_HEADER_SIZE);
+  memcpy(packet, id, sizeof(id));
+  packet[9] = 0x50;
+  packet[11] = 14;
+  packet[12] = sequence;
+  packet[14] = universe & 0xFF;
+  packet[15] = universe >> 8;
+  packet[16] = count >> 8;
+  packet[17] = count & 0xFF;
+  memcpy(packet + ARTNET_HEADER_SIZE, slots, count);
+  return ARTNET_HEADER_SIZE + count;
+}
+
+// Builds an E1.31 data packet with start code 0, returns its length
+static size_t e131(uint8_t *packet, uint16_t universe, uint8_t sequence, const uint8_t *slots, uint16_t count) {
+  static const uint8_t id[12] = { 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0 };
+  memset(packet, 0, E131_HEADER_SIZE);
+  packet[1] = 0x10;
+  memcpy(packet + 4, id, sizeof(id));
+  packet[21] = 0x04;
+  packet[43] = 0x02;
+  packet[108] = 100;
+  packet[111] = sequence;
+  packet[113] = universe >> 8;
+  packet[114] = universe & 0xFF;
+  packet[117] = 0x02;
+  packet[118] = 0xA1;
+  packet[122] = 1;
+  packet[123] = (count + 1) >> 8;
+  packet[124] = (count + 1) & 0xFF;
+  memcpy(packet + E131_HEADER_SIZE, slots, count);
+  return E131_HEADER_SIZE + count;
+}
+
+// Returns true if every member shows the slots patched from an address
+static bool shows(const uint8_t *slots, uint16_t address) {
+  for(uint8_t i = 0; i < MEMBERS; i++) {
+    if(HostPwm::value(FIRST_PIN + i) != dutyOf(slots[address - 1 + i])) return false;
+  }
+  return true;
+}
+
+// Returns the number of writes made to the members
+static size_t memberWrites() {
+  size_t writes = 0;
+  for(uint8_t i = 0; i < MEMBERS; i++) writes += HostPwm::count(FIRST_PIN + i);
+  return writes;
+}
+
+int main() {
+  Led leds[MEMBERS];
+  LedGroup group;
+  for(uint8_t i = 0; i < MEMBERS; i++) group.add(leds[i].setPin(FIRST_PIN + i).setStyle(REG));
+
+  uint8_t slots[DMX_SLOTS];
+  for(uint16_t i = 0; i < DMX_SLOTS; i++) slots[i] = (i * 37 + 11) & 0xFF;
+  uint8_t packet[DMX_PACKET_MAX];
+  size_t length;
+  DmxFrame frame;
+
+  LedDmx dmx(group, 1, 1);
+
+  // Art-Net, a numbered frame for this universe is applied to every member
+  length = artnet(packet, 1, 1, slots, DMX_SLOTS);
+  CHECK(LedDmx::parse(packet, length, frame));
+  CHECK_EQ(frame.protocol, DMX_ARTNET);
+  CHECK_EQ(frame.universe, 1);
+  CHECK_EQ(frame.count, DMX_SLOTS);
+  CHECK(frame.slots == packet + ARTNET_HEADER_SIZE);
+  CHECK(dmx.receive(packet, length));
+  CHECK(shows(slots, 1));
+  CHECK_EQ(dmx.getFrames(), 1);
+
+  // The same frame again is a duplicate
+  CHECK(!dmx.receive(packet, length));
+  CHECK_EQ(dmx.getOutOfOrder(), 1);
+
+  // The next frame writes only the slot that changed
+  size_t writes = memberWrites();
+  slots[2] ^= 0x80;
+  length = artnet(packet, 1, 2, slots, DMX_SLOTS);
+  CHECK(dmx.receive(packet, length));
+  CHECK_EQ(memberWrites() - writes, 1);
+  CHECK(shows(slots, 1));
+
+  // A late frame is dropped, one far enough behind is a restarted sender
+  length = artnet(packet, 1, 1, slots, DMX_SLOTS);
+  CHECK(!dmx.receive(packet, length));
+  CHECK_EQ(dmx.getOutOfOrder(), 2);
+  length = artnet(packet, 1, 200, slots, DMX_SLOTS);
+  CHECK(dmx.receive(packet, length));
+
+  // Sequence 0 is an unnumbered sender, always applied
+  length = artnet(packet, 1, 0, slots, DMX_SLOTS);
+  CHECK(dmx.receive(packet, length));
+  CHECK(dmx.receive(packet, length));
+  CHECK_EQ(dmx.getOutOfOrder(), 2);
+  CHECK_EQ(dmx.getFrames(), 5);
+
+  // Another universe is ignored without touching the sequence
+  writes = memberWrites();
+  length = artnet(packet, 2, 50, slots, DMX_SLOTS);
+  CHECK(LedDmx::parse(packet, length, frame));
+  CHECK(!dmx.receive(packet, length));
+  CHECK_EQ(memberWrites() - writes, 0);
+  CHECK_EQ(dmx.getFrames(), 5);
+  CHECK_EQ(dmx.getOutOfOrder(), 2);
+
+  // Bad headers are not parsed
+  length = artnet(packet, 1, 0, slots, DMX_SLOTS);
+  packet[0] = 'a';
+  CHECK(!dmx.receive(packet, length));
+  length = artnet(packet, 1, 0, slots, DMX_SLOTS);
+  packet[9] = 0x20;                                     // ArtPoll
+  CHECK(!dmx.receive(packet, length));
+  length = artnet(packet, 1, 0, slots, DMX_SLOTS);
+  packet[11] = 13;                                      // Old protocol
+  CHECK(!dmx.receive(packet, length));
+  length = artnet(packet, 1, 0, slots, 0);
+  CHECK(!dmx.receive(packet, length));
+  length = artnet(packet, 1, 0, slots, DMX_SLOTS);
+  CHECK(!dmx.receive(packet, length - 1));              // Truncated
+  CHECK(!dmx.receive(packet, ARTNET_HEADER_SIZE - 1));
+  CHECK(!dmx.receive(nullptr, length));
+  CHECK_EQ(memberWrites() - writes, 0);
+  CHECK_EQ(dmx.getFrames(), 5);
+
+  // E1.31, applied the same way from its own header
+  for(uint16_t i = 0; i < DMX_SLOTS; i++) slots[i] = 255 - slots[i];
+  length = e131(packet, 1, 10, slots, DMX_SLOTS);
+  CHECK(LedDmx::parse(packet, length, frame));
+  CHECK_EQ(frame.protocol, DMX_E131);
+  CHECK_EQ(frame.count, DMX_SLOTS);
+  CHECK(dmx.receive(packet, length));
+  CHECK(shows(slots, 1));
+  CHECK(!dmx.receive(packet, length));
+  CHECK_EQ(dmx.getOutOfOrder(), 3);
+
+  // Setting the universe starts a fresh count, E1.31 sequence 0 is an ordinary number that follows 255
+  dmx.setUniverse(1);
+  length = e131(packet, 1, 255, slots, DMX_SLOTS);
+  CHECK(dmx.receive(packet, length));
+  length = e131(packet, 1, 0, slots, DMX_SLOTS);
+  CHECK(dmx.receive(packet, length));
+  CHECK(!dmx.receive(packet, length));
+  CHECK_EQ(dmx.getOutOfOrder(), 4);
+
+  // Preview, stopped, another start code, a wrong vector or a short packet is not applied
+  writes = memberWrites();
+  length = e131(packet, 1, 20, slots, DMX_SLOTS);
+  packet[112] = 0x80;
+  CHECK(!dmx.receive(packet, length));
+  packet[112] = 0x40;
+  CHECK(!dmx.receive(packet, length));
+  length = e131(packet, 1, 20, slots, DMX_SLOTS);
+  packet[125] = 0xDD;
+  CHECK(!dmx.receive(packet, length));
+  length = e131(packet, 1, 20, slots, DMX_SLOTS);
+  packet[21] = 0x08;
+  CHECK(!dmx.receive(packet, length));
+  length = e131(packet, 1, 20, slots, DMX_SLOTS);
+  CHECK(!dmx.receive(packet, length - 1));
+  length = e131(packet, 2, 20, slots, DMX_SLOTS);
+  CHECK(!dmx.receive(packet, length));
+  CHECK_EQ(memberWrites() - writes, 0);
+
+  // A start address shifts the patch, a short frame only drives the members it reaches
+  dmx.setAddress(100);
+  length = e131(packet, 1, 30, slots, DMX_SLOTS);
+  CHECK(dmx.receive(packet, length));
+  CHECK(shows(slots, 100));
+  for(uint16_t i = 0; i < DMX_SLOTS; i++) slots[i] ^= 0x55;
+  length = e131(packet, 1, 31, slots, 103);
+  CHECK(dmx.receive(packet, length));
+  CHECK_EQ(HostPwm::value(FIRST_PIN + 3), dutyOf(slots[102]));
+  CHECK(HostPwm::value(FIRST_PIN + 4) != dutyOf(slots[103]));
+
+  // A patch past slot 512 is refused until it is moved back
+  dmx.setAddress(DMX_SLOTS - MEMBERS + 2);
+  CHECK(!dmx.fits());
+  writes = memberWrites();
+  length = e131(packet, 1, 40, slots, DMX_SLOTS);
+  CHECK(!dmx.receive(packet, length));
+  CHECK_EQ(dmx.apply(slots, DMX_SLOTS), 0);
+  CHECK_EQ(memberWrites() - writes, 0);
+  dmx.setAddress(DMX_SLOTS - MEMBERS + 1);
+  CHECK(dmx.fits());
+  CHECK(dmx.receive(packet, length));
+  CHECK(shows(slots, DMX_SLOTS - MEMBERS + 1));
+
+  // Throughput of full universes, every patched slot changing each frame
+  HostPwm::setRecording(false);
+  dmx.setAddress(1);
+  const uint32_t frames = 200000;
+  const uint32_t before = dmx.getFrames();
+  typedef std::chrono::steady_clock clock;
+  const clock::time_point start = clock::now();
+  for(uint32_t i = 0; i < frames; i++) {
+    length = artnet(packet, 1, 1 + i % 255, slots, DMX_SLOTS);
+    for(uint8_t j = 0; j < MEMBERS; j++) packet[ARTNET_HEADER_SIZE + j] = i + j * 32;
+    dmx.receive(packet, length);
+  }
+  const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+  CHECK_EQ(dmx.getFrames() - before, frames);
+  printf("receive: %.0f frames/s, %u members, packet built each frame\n", frames / seconds, MEMBERS);
+
+  // The same over UDP, each frame sent to 127.0.0.1 and read back before receive()
+  const int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addrLength = sizeof(addr);
+  if(sock < 0 || bind(sock, (sockaddr *)&addr, addrLength) != 0 || getsockname(sock, (sockaddr *)&addr, &addrLength) != 0) {
+    printf("loopback: no UDP socket, skipped\n");
+  } else {
+    const uint32_t udpFrames = 20000;
+    const uint32_t udpBefore = dmx.getFrames();
+    uint8_t received[DMX_PACKET_MAX];
+    bool delivered = true;
+    const clock::time_point udpStart = clock::now();
+    for(uint32_t i = 0; i < udpFrames && delivered; i++) {
+      length = e131(packet, 1, i, slots, DMX_SLOTS);
+      for(uint8_t j = 0; j < MEMBERS; j++) packet[E131_HEADER_SIZE + j] = i + j * 32;
+      delivered = sendto(sock, packet, length, 0, (sockaddr *)&addr, addrLength) == (ssize_t)length;
+      const ssize_t got = delivered ? recvfrom(sock, received, sizeof(received), 0, nullptr, nullptr) : -1;
+      delivered = got == (ssize_t)length && dmx.receive(received, got);
+    }
+    const double udpSeconds = std::chrono::duration<double>(clock::now() - udpStart).count();
+    CHECK(delivered);
+    CHECK_EQ(dmx.getFrames() - udpBefore, udpFrames);
+    CHECK(shows(received + E131_HEADER_SIZE, 1));
+    printf("loopback: %.0f frames/s, %u members, sendto and recvfrom each frame\n", udpFrames / udpSeconds, MEMBERS);
+  }
+  if(sock >= 0) close(sock);
+
+  return testResult("DmxTest");
+}
@@ -0,0 +1,71 @@
+/*
+  GroupTest.cpp
+
+  Checks that LedGroup writes only changed members and leaves each member's
+  on state matching the level it was given.
+
+  The group is filled to ESPLED_GROUP_SIZE. Build it a second time with
+  -DESPLED_GROUP_SIZE=300 to cover groups of more than 255 members. A
+  second group is built over garbage, as on the stack or the heap, to
+  check that nothing relies on zeroed memory.
+
+*/
+
+#include <ESPLed.h>
+#include <HostBackend.h>
+#include <new>
+#include <string.h>
+#include <vector>
+#include "HostTest.h"
+
+int main() {
+  std::vector<Led> leds(ESPLED_GROUP_SIZE);
+  LedGroup group;
+  for(uint16_t i = 0; i < ESPLED_GROUP_SIZE; i++) {
+    leds[i].setPin(i % 200).setStyle(REG).off();
+    CHECK(group.add(leds[i]));
+  }
+  CHECK_EQ(group.size(), ESPLED_GROUP_SIZE);
+
+  Led extra(201, REG);
+  CHECK(!group.add(extra));
+
+  // Every member changes, then nothing does
+  CHECK_EQ(group.setAll(50).flush(), ESPLED_GROUP_SIZE);
+  CHECK_EQ(group.setAll(50).flush(), 0);
+  for(uint16_t i = 0; i < ESPLED_GROUP_SIZE; i++) CHECK(leds[i].isOn());
+
+  // Only the last member changes
+  const uint16_t last = ESPLED_GROUP_SIZE - 1;
+  group.set(last, 80);
+  CHECK(group.isDirty(last));
+  CHECK(!group.isDirty(0));
+  CHECK_EQ(group.flush(), 1);
+
+  // A member staged at its minimum is off, toggle() turns it back on
+  CHECK_EQ(group.setAll(0).flush(), ESPLED_GROUP_SIZE);
+  CHECK(!leds[0].isOn());
+  CHECK(!leds[last].isOn());
+  leds[0].toggle();
+  CHECK(leds[0].isOn());
+  CHECK(HostPwm::value(0) > 0);
+
+  // Above the minimum counts as on
+  leds[1].setMinBrightness(10);
+  group.set(1, 10).set(2, 1);
+  group.flush();
+  CHECK(!leds[1].isOn());
+  CHECK(leds[2].isOn());
+
+  // A group in memory that was never zeroed, ie on the stack or the heap, has no stray dirty members
+  alignas(LedGroup) static uint8_t garbage[sizeof(LedGroup)];
+  memset(garbage, 0xFF, sizeof(garbage));
+  LedGroup *partial = new (garbage) LedGroup();
+  for(uint8_t i = 0; i < 3; i++) CHECK(partial->add(leds[i]));
+  for(uint16_t i = 0; i < ESPLED_GROUP_SIZE; i++) CHECK(!partial->isDirty(i));
+  CHECK_EQ(partial->flush(), 0);
+  CHECK_EQ(partial->setAll(20).flush(), 3);
+  partial->~LedGroup();
+
+  return testResult("GroupTest");
+}
@@ -0,0 +1,43 @@
+/*
+  HostTest.h
+
+  Minimal checks for the host test programs in extras/test. Each program
+  is built like the benchmark (see Host Builds in README.md), prints every
+  failed check and exits non zero if any failed.
+
+*/
+
+#ifndef ESPLED_HOST_TEST_H
+#define ESPLED_HOST_TEST_H
+
+#include <stdio.h>
+
+static unsigned long _checks = 0;
+static unsigned long _failures = 0;
+
+// Records a condition, printing it if it does not hold
+#define CHECK(cond) do { \
+    _checks++; \
+    if(!(cond)) { \
+      _failures++; \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+    } \
+  } while(0)
+
+// Records that two integers are equal, printing both if they are not
+#define CHECK_EQ(a, b) do { \
+    _checks++; \
+    const long long _a = (long long)(a), _b = (long long)(b); \
+    if(_a != _b) { \
+      _failures++; \
+      printf("%s:%d: CHECK_EQ(%s, %s) failed, %lld != %lld\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+    } \
+  } while(0)
+
+// Prints a summary, returns the exit code for main()
+static int testResult(const char *name) {
+  printf("%s: %lu checks, %lu failed\n", name, _checks, _failures);
+  return _failures ? 1 : 0;
+}
+
+#endif
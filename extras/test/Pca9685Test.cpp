@@ -0,0 +1,83 @@
+/*
+  Pca9685Test.cpp
+
+  Drives 16 Leds through a Pca9685 on HostWire and checks how many I2C
+  transactions and bytes each change costs, including a frame the chip
+  does not acknowledge.
+
+*/
+
+#include <ESPLed.h>
+#include <Pca9685.h>
+#include <HostBackend.h>
+#include "HostTest.h"
+
+// One register address byte plus 4 per channel
+#define FRAME_BYTES(channels) (1 + 4 * (channels))
+
+int main() {
+  HostWire wire;
+  Pca9685<HostWire> expander(wire);
+
+  // MODE2, then MODE1 sleep, prescale, MODE1 wake and restart
+  CHECK(expander.begin(1000));
+  CHECK_EQ(wire.transactions(), 5);
+  CHECK_EQ(wire.bytes(), 5 * 2);
+  CHECK_EQ(wire.last()[0], PCA9685_MODE1);
+  CHECK_EQ(wire.last()[1], PCA9685_RESTART | PCA9685_AI | PCA9685_ALLCALL);
+  wire.clear();
+
+  Led leds[PCA9685_CHANNELS];
+  for(uint8_t i = 0; i < PCA9685_CHANNELS; i++) leds[i].setOutput(expander, i).setStyle(REG);
+
+  // Writes only buffer, the whole chip goes out in one frame
+  for(uint8_t i = 0; i < PCA9685_CHANNELS; i++) leds[i].on(50);
+  CHECK_EQ(wire.transactions(), 0);
+  expander.flush();
+  CHECK_EQ(wire.transactions(), 1);
+  CHECK_EQ(wire.bytes(), FRAME_BYTES(PCA9685_CHANNELS));
+
+  // Nothing changed, nothing is sent
+  expander.flush();
+  CHECK_EQ(wire.transactions(), 1);
+
+  // Channels 3 and 5 change, the frame covers 3 to 5
+  wire.clear();
+  leds[3].on(80);
+  leds[5].off();
+  CHECK(expander.isDirty(3));
+  CHECK(!expander.isDirty(4));
+  expander.flush();
+  CHECK_EQ(wire.transactions(), 1);
+  CHECK_EQ(wire.bytes(), FRAME_BYTES(3));
+  CHECK_EQ(wire.last()[0], PCA9685_LED0 + 4 * 3);
+  CHECK_EQ(wire.last()[4 * 2 + 4], PCA9685_FULL);    // Channel 5 OFF_H, full off
+
+  // A frame that is not acknowledged stays dirty and is sent again
+  wire.clear();
+  wire.setNack(true);
+  leds[7].on(100);
+  expander.flush();
+  CHECK_EQ(expander.getErrors(), 1);
+  CHECK(expander.isDirty(7));
+  wire.setNack(false);
+  expander.flush();
+  CHECK_EQ(expander.getErrors(), 1);
+  CHECK(!expander.isDirty(7));
+  CHECK_EQ(wire.transactions(), 1);
+  CHECK_EQ(wire.bytes(), FRAME_BYTES(1));
+  CHECK_EQ(wire.last()[2], PCA9685_FULL);            // Channel 7 ON_H, full on
+
+  // Animated Leds are sent once per scheduler pass that wrote any of them
+  wire.clear();
+  leds[0].setPeriod(1000).pulse().start();
+  leds[1].setPeriod(1000).pulse().start();
+  HostClock::advanceMs(1000);
+  CHECK(wire.transactions() > 30);
+  CHECK(wire.transactions() <= 61);
+  CHECK_EQ(wire.bytes(), wire.transactions() * FRAME_BYTES(2));
+  leds[0].stop();
+  leds[1].stop();
+
+  return testResult("Pca9685Test");
+}
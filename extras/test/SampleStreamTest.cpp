@@ -0,0 +1,117 @@
+/*
+  SampleStreamTest.cpp
+
+  Feeds known ramps through a LedSamples ring into a streaming Led and
+  checks the recorded PWM writes. Every write must land on the refresh
+  grid and carry the duty a Led set to the expected level would have.
+
+  A second, idle Led on another pin maps levels to duties for reference.
+
+*/
+
+#include <ESPLed.h>
+#include <HostBackend.h>
+#include <vector>
+#include "HostTest.h"
+
+#define PIN           5
+#define REF_PIN       6
+#define REFRESH_HZ    100
+#define REFRESH_US    (1000000 / REFRESH_HZ)
+
+static Led ref(REF_PIN, REG);
+
+// Returns the duty a Led with the default range writes for a level
+static uint16_t dutyOf(uint16_t level) {
+  ref.onLevel(level);
+  return HostPwm::value(REF_PIN);
+}
+
+// Returns the writes made to PIN since the last HostPwm::clear()
+static std::vector<PwmWrite> streamWrites() {
+  std::vector<PwmWrite> writes;
+  for(const PwmWrite &write : HostPwm::writes()) {
+    if(write.pin == PIN) writes.push_back(write);
+  }
+  return writes;
+}
+
+int main() {
+  HostPwm::setRecording(true);
+  LedSamples samples;
+  Led led(PIN, REG);
+  led.setRefreshRate(REFRESH_HZ);
+
+  // Latest, one sample per refresh, a 30% to 99% ramp gives a new duty every step
+  // The first refresh is due at start() and finds nothing, a sample pushed before each later one is read by it
+  led.stream(samples, STREAM_LATEST);
+  HostPwm::clear();
+  uint64_t start = HostClock::now();
+  led.start();
+  HostClock::advance(0);
+  for(uint8_t i = 0; i < 70; i++) {
+    CHECK(samples.push(percentToLevel(30 + i)));
+    HostClock::advance(REFRESH_US);
+  }
+
+  std::vector<PwmWrite> writes = streamWrites();
+  CHECK_EQ(writes.size(), 70);
+  for(size_t i = 0; i < writes.size(); i++) {
+    CHECK_EQ(writes[i].time_us, start + (i + 1) * REFRESH_US);
+    CHECK_EQ(writes[i].value, dutyOf(percentToLevel(30 + i)));
+  }
+
+  // Refreshes without a sample hold the output and write nothing
+  HostPwm::clear();
+  HostClock::advance(10 * REFRESH_US);
+  CHECK_EQ(streamWrites().size(), 0);
+
+  // Average, a ramp at three samples per refresh resamples to its middle sample
+  led.stream(samples, STREAM_AVERAGE);
+  HostPwm::clear();
+  start = HostClock::now();
+  led.start();
+  HostClock::advance(0);
+  for(uint8_t i = 0; i < 20; i++) {
+    for(uint8_t j = 0; j < 3; j++) CHECK(samples.push(percentToLevel(30 + 3 * i + j)));
+    HostClock::advance(REFRESH_US);
+  }
+
+  writes = streamWrites();
+  CHECK_EQ(writes.size(), 20);
+  for(size_t i = 0; i < writes.size(); i++) {
+    CHECK_EQ(writes[i].time_us, start + (i + 1) * REFRESH_US);
+    CHECK_EQ(writes[i].value, dutyOf(percentToLevel(30 + 3 * i + 1)));
+  }
+
+  // Peak, a high sample is written at once then decays on the grid while lower ones follow
+  led.stream(samples, STREAM_PEAK, 128);
+  HostPwm::clear();
+  start = HostClock::now();
+  led.start();
+  HostClock::advance(0);
+  CHECK(samples.push(LED_LEVEL_MAX / 4));
+  CHECK(samples.push(LED_LEVEL_MAX));
+  CHECK(samples.push(LED_LEVEL_MAX / 2));
+  HostClock::advance(REFRESH_US);
+  for(uint8_t i = 0; i < 6; i++) {
+    CHECK(samples.push(0));
+    HostClock::advance(REFRESH_US);
+  }
+
+  writes = streamWrites();
+  CHECK_EQ(writes.size(), 7);
+  CHECK_EQ(writes[0].value, dutyOf(LED_LEVEL_MAX));
+  for(size_t i = 0; i < writes.size(); i++) {
+    CHECK_EQ(writes[i].time_us, start + (i + 1) * REFRESH_US);
+    if(i > 0) CHECK(writes[i].value < writes[i - 1].value);
+  }
+
+  // A full ring turns samples away rather than growing
+  uint16_t accepted = 0;
+  for(uint16_t i = 0; i < 2 * ESPLED_STREAM_SAMPLES; i++) accepted += samples.push(LED_LEVEL_MAX);
+  CHECK_EQ(accepted, ESPLED_STREAM_SAMPLES);
+
+  led.stop();
+  return testResult("SampleStreamTest");
+}
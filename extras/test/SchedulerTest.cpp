@@ -0,0 +1,69 @@
+/*
+  SchedulerTest.cpp
+
+  Starts 1000 pulsing Leds on one scheduler and checks that every one of
+  them is scheduled and animated. Leds write to counting outputs so each
+  channel can be told apart.
+
+*/
+
+#include <ESPLed.h>
+#include <HostBackend.h>
+#include <vector>
+#include "HostTest.h"
+
+#define LEDS          1000
+#define PER_OUTPUT    250
+
+// Counts the writes made to each channel
+class CountingOutput : public LedOutput {
+public:
+  uint32_t writes[PER_OUTPUT] = {};
+protected:
+  void _write(uint8_t channel, uint32_t, uint8_t) { writes[channel]++; }
+};
+
+int main() {
+  LedScheduler &scheduler = LedScheduler::getInstance();
+  CHECK_EQ(scheduler.capacity(), ESPLED_SCHEDULER_SIZE);
+
+  std::vector<CountingOutput> outputs(LEDS / PER_OUTPUT);
+  std::vector<Led> leds(LEDS);
+  for(uint16_t i = 0; i < LEDS; i++) {
+    leds[i].setOutput(outputs[i / PER_OUTPUT], i % PER_OUTPUT);
+    leds[i].setPeriod(1000).pulse().start();
+  }
+
+  // The heap grows past its static slots rather than dropping Leds
+  CHECK_EQ(scheduler.size(), LEDS);
+  CHECK(scheduler.capacity() >= LEDS);
+  uint16_t started = 0;
+  for(uint16_t i = 0; i < LEDS; i++) started += leds[i].isStarted();
+  CHECK_EQ(started, LEDS);
+
+  HostClock::advanceMs(1000);
+
+  // A 1s pulse at 60Hz changes its output on most of its 61 refreshes, plus the write at start
+  uint32_t fewest = UINT32_MAX, most = 0;
+  for(uint16_t i = 0; i < LEDS; i++) {
+    const uint32_t writes = outputs[i / PER_OUTPUT].writes[i % PER_OUTPUT];
+    if(writes < fewest) fewest = writes;
+    if(writes > most) most = writes;
+  }
+  printf("writes per Led in 1s: %u to %u\n", fewest, most);
+  CHECK(fewest >= 30);
+  CHECK(most <= 62);
+
+  // Stopping releases every slot
+  for(uint16_t i = 0; i < LEDS; i++) leds[i].stop();
+  CHECK_EQ(scheduler.size(), 0);
+
+  // Room can be made up front, shrinking is never done
+  CHECK(scheduler.reserve(2000));
+  CHECK_EQ(scheduler.capacity(), 2000);
+  CHECK(scheduler.reserve(10));
+  CHECK_EQ(scheduler.capacity(), 2000);
+  CHECK(!scheduler.reserve(ESPLED_SCHEDULER_MAX + 1));
+
+  return testResult("SchedulerTest");
+}
@@ -0,0 +1,133 @@
+/*
+  SchedulerTest32.cpp
+
+  Runs the ESP32 scheduler on the host: the scheduler task, its one shot
+  esp_timer, and setter calls queued by other tasks and by ISRs. Built
+  with -DESP32, like every test whose name ends in 32, so FreeRTOS and
+  esp_timer come from extras/host/HostRtos.
+
+  Writes are recorded against LEDC channels rather than pins.
+
+*/
+
+#include <ESPLed.h>
+#include <HostBackend.h>
+#include "HostTest.h"
+
+#ifndef ESP32
+#error "Build with -DESP32"
+#endif
+
+#define REFRESH_HZ    300
+#define REFRESH_US    (1000000 / REFRESH_HZ)
+
+ESPLED_BRIGHTNESS_LUT(testLut, 12, CieCurve);
+
+// Returns the writes made to a channel since a time
+static size_t writesSince(uint8_t channel, uint64_t from_us) {
+  size_t count = 0;
+  for(const PwmWrite &write : HostPwm::writes()) count += (write.pin == channel && write.time_us >= from_us);
+  return count;
+}
+
+int main() {
+  LedScheduler &scheduler = LedScheduler::getInstance();
+  Led pulsing(4, REG);
+  Led idle(5, REG);
+  const uint8_t channel = pulsing.getChannel();
+  CHECK(channel != ESPLED_NO_CHANNEL);
+  CHECK(idle.getChannel() != channel);
+
+  // The first animated Led starts the task, which sleeps on the us timer between refreshes
+  pulsing.setRefreshRate(REFRESH_HZ).setPeriod(1000).pulse().start();
+  const uint64_t start = HostClock::now();
+  HostClock::advance(0);
+  CHECK(HostRtos::switches() > 0);
+
+  // Refreshes keep their us cadence, no rounding to ms or RTOS ticks
+  HostPwm::clear();
+  HostClock::advanceTo(start + 1000000 - 1);
+  size_t ticks = 0;
+  bool onGrid = true;
+  for(const PwmWrite &write : HostPwm::writes()) {
+    if(write.pin != channel) continue;
+    ticks++;
+    onGrid = onGrid && (write.time_us - start) % REFRESH_US == 0;
+  }
+  printf("writes in 1s at %uHz: %u\n", REFRESH_HZ, (unsigned)ticks);
+  CHECK(onGrid);
+  CHECK(ticks > REFRESH_HZ / 2);
+  CHECK(ticks <= REFRESH_HZ);
+
+  // Setters from the loop task on an animated Led wait for the scheduler task
+  pulsing.setMaxLevel(LED_LEVEL_MAX / 2);
+  CHECK_EQ(pulsing.getMaxLevel(), LED_LEVEL_MAX);
+  HostClock::advance(0);
+  CHECK_EQ(pulsing.getMaxLevel(), LED_LEVEL_MAX / 2);
+
+  // Setters from an ISR are queued even on an idle Led, and never lock or write
+  const uint64_t isrAt = HostClock::now();
+  HostRtos::isr([&]() { idle.onLevel(LED_LEVEL_MAX / 2); });
+  HostRtos::isr([&]() { pulsing.setPeriod(2000); });
+  CHECK_EQ(HostRtos::isrViolations(), 0);
+  CHECK(!idle.isOn());
+  CHECK_EQ(writesSince(idle.getChannel(), isrAt), 0);
+  HostClock::advance(0);
+  CHECK(idle.isOn());
+  CHECK_EQ(writesSince(idle.getChannel(), isrAt), 1);
+  CHECK_EQ(pulsing.getPeriod(), 2000);
+
+  // Fades, style, table and transition from an ISR are queued too
+  HostRtos::isr([&]() {
+    idle.off(100);
+    idle.setStyle(INVERTED).setBrightnessLut(testLut).setTransition(50);
+  });
+  CHECK_EQ(HostRtos::isrViolations(), 0);
+  CHECK(!idle.isFading());
+  CHECK_EQ(idle.getStyle(), REG);
+  HostClock::advance(0);
+  CHECK(idle.isFading());
+  CHECK_EQ(idle.getStyle(), INVERTED);
+  CHECK_EQ(idle.getResolution(), 12);
+  CHECK_EQ(idle.getTransition(), 50);
+  HostClock::advanceMs(200);
+  CHECK(!idle.isFading());
+  CHECK(!idle.isOn());
+
+  // A table set from the loop task on an animated Led is swapped by the scheduler task, never mid tick
+  pulsing.setBrightnessLut(testLut);
+  CHECK(pulsing.getResolution() != 12);
+  HostClock::advance(0);
+  CHECK_EQ(pulsing.getResolution(), 12);
+
+  // A full ISR ring drops the call and counts it
+  HostRtos::isr([&]() {
+    for(uint8_t i = 0; i < ESPLED_ISR_QUEUE + 4; i++) idle.toggle();
+  });
+  CHECK_EQ(HostRtos::isrViolations(), 0);
+  CHECK_EQ(scheduler.getDropped(), 4);
+  HostClock::advance(0);
+
+  // A Led due sooner than the next refresh wakes the task early
+  Led blinking(6, REG);
+  blinking.setInterval(1).setDuration(1).blink().start();
+  const uint64_t blinkAt = HostClock::now();
+  HostClock::advanceMs(10);
+  CHECK(writesSince(blinking.getChannel(), blinkAt) >= 9);
+
+  // Queued calls for a Led are applied before it is destroyed
+  {
+    Led shortLived(7, REG);
+    shortLived.setPeriod(500).pulse().start();
+    HostClock::advance(0);
+    shortLived.setPeriod(700);
+  }
+  HostClock::advanceMs(10);
+
+  pulsing.stop();
+  blinking.stop();
+  HostClock::advanceMs(10);
+  CHECK_EQ(scheduler.size(), 0);
+
+  return testResult("SchedulerTest32");
+}
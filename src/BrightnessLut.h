@@ -0,0 +1,133 @@
+/*
+  BrightnessLut.h
+
+  Perceived brightness curves evaluated at compile time. A table maps a
+  percent [0,100] onto a PWM value of 8 to 16 bits and is generated by
+  constexpr code, so it costs nothing at runtime and only the tables a
+  sketch actually declares are linked in.
+
+  Declare a table in flash and hand it to a Led, ie
+
+    ESPLED_BRIGHTNESS_LUT(cieLut, 14, CieCurve);
+    led.setBrightnessLut(cieLut);
+
+*/
+
+#ifndef ESPLED_BRIGHTNESS_LUT_H
+#define ESPLED_BRIGHTNESS_LUT_H
+
+#include <Arduino.h>
+
+#define BRIGHTNESS_STEPS 101
+
+// High resolution brightness, table entries are LED_LEVELS_PER_PERCENT apart
+// and PWM values in between are interpolated
+#define LED_LEVELS_PER_PERCENT  655
+#define LED_LEVEL_MAX           (100 * LED_LEVELS_PER_PERCENT)
+#define percentToLevel(percent) ((uint16_t)(percent) * LED_LEVELS_PER_PERCENT)
+#define levelToPercent(level)   ((uint8_t)((level) / LED_LEVELS_PER_PERCENT))
+
+// PWM values for each percent along with the resolution they were made for
+struct BrightnessLut {
+  uint8_t bits;
+  uint16_t value[BRIGHTNESS_STEPS];
+};
+
+// Declares a table generated at compile time and placed in flash
+#define ESPLED_BRIGHTNESS_LUT(name, bits, curve) \
+  constexpr BrightnessLut name PROGMEM = makeBrightnessLut<bits, curve>()
+
+
+
+/*
+  constexpr math
+  Written as single return statements to stay within C++11
+*/
+#define LUT_LN2 0.69314718055994530942
+
+// atanh series, sum of z^n / n over odd n
+constexpr double _lutAtanh(double z2, double term, unsigned n) {
+  return (n > 61) ? 0 : term / n + _lutAtanh(z2, term * z2, n + 2);
+}
+
+// Natural log, reduced onto [1,2) before using the series
+constexpr double lutLn(double x) {
+  return (x >= 2) ? LUT_LN2 + lutLn(x / 2)
+       : (x < 1)  ? lutLn(x * 2) - LUT_LN2
+       : 2 * _lutAtanh(((x - 1) / (x + 1)) * ((x - 1) / (x + 1)), (x - 1) / (x + 1), 1);
+}
+
+// Taylor series for e^x on [-0.5,0.5]
+constexpr double _lutExpTaylor(double x, double term, unsigned n) {
+  return (n > 24) ? term : term + _lutExpTaylor(x, term * x / n, n + 1);
+}
+
+constexpr double _lutSquare(double x) { return x * x; }
+
+// e^x, halving x until the series converges quickly
+constexpr double lutExp(double x) {
+  return (x > 0.5 || x < -0.5) ? _lutSquare(lutExp(x / 2)) : _lutExpTaylor(x, 1, 1);
+}
+
+constexpr double lutPow(double x, double y) {
+  return (x <= 0) ? 0 : lutExp(y * lutLn(x));
+}
+
+
+
+/*
+  Curves
+  map() takes a percent [0,100] and returns the relative duty [0,1]
+*/
+
+// Antilog curve used by ESPLed since the beginning
+struct AntilogCurve {
+  static constexpr double map(unsigned percent) {
+    return 1 - lutLn(BRIGHTNESS_STEPS - percent) / lutLn(BRIGHTNESS_STEPS);
+  }
+};
+
+// CIE 1931 lightness, percent is taken as L*
+struct CieCurve {
+  static constexpr double map(unsigned percent) {
+    return (percent > 8) ? lutPow((percent + 16) / 116.0, 3) : percent / 903.3;
+  }
+};
+
+// Power law, gamma given in tenths, ie GammaCurve<22> for 2.2
+template<unsigned Tenths>
+struct GammaCurve {
+  static constexpr double map(unsigned percent) {
+    return lutPow(percent / 100.0, Tenths / 10.0);
+  }
+};
+
+
+
+/*
+  Table generation
+*/
+template<unsigned... I> struct LutIndices {};
+template<unsigned N, unsigned... I> struct MakeLutIndices : MakeLutIndices<N - 1, N - 1, I...> {};
+template<unsigned... I> struct MakeLutIndices<0, I...> { typedef LutIndices<I...> type; };
+
+template<uint8_t Bits, typename Curve>
+constexpr uint16_t _lutValue(unsigned percent) {
+  return uint16_t(Curve::map(percent) * ((1UL << Bits) - 1) + 0.5);
+}
+
+template<uint8_t Bits, typename Curve, unsigned... I>
+constexpr BrightnessLut _makeBrightnessLut(LutIndices<I...>) {
+  return BrightnessLut{ Bits, { _lutValue<Bits, Curve>(I)... } };
+}
+
+template<uint8_t Bits, typename Curve>
+constexpr BrightnessLut makeBrightnessLut() {
+  static_assert(Bits >= 8 && Bits <= 16, "Brightness tables support 8 to 16 bit resolution");
+  return _makeBrightnessLut<Bits, Curve>(typename MakeLutIndices<BRIGHTNESS_STEPS>::type());
+}
+
+// Default 10 bit table, matches the ESP8266 analogWrite() range
+extern const BrightnessLut _brightnessLut;
+
+#endif
@@ -1,55 +1,23 @@
 #include "ESPLed.h"
 
 
-// Antilog percent to [0,1023] lookup table
-const uint16_t _brightnessLut[101] PROGMEM = {
-  0x000,	0x002,	0x004,	0x007,	0x009,
-  0x00b,	0x00e,	0x010,	0x012,	0x015,
-  0x017,	0x01a,	0x01c,	0x01f,	0x021,
-  0x024,	0x026,	0x029,	0x02c,	0x02e,
-  0x031,	0x034,	0x036,	0x039,	0x03c,
-  0x03f,	0x042,	0x045,	0x048,	0x04b,
-  0x04e,	0x051,	0x054,	0x058,	0x05b,
-  0x05e,	0x062,	0x065,	0x069,	0x06c,
-  0x070,	0x073,	0x077,	0x07b,	0x07f,
-  0x083,	0x087,	0x08b,	0x08f,	0x093,
-  0x097,	0x09c,	0x0a0,	0x0a5,	0x0aa,
-  0x0ae,	0x0b3,	0x0b8,	0x0bd,	0x0c2,
-  0x0c8,	0x0cd,	0x0d3,	0x0d9,	0x0df,
-  0x0e5,	0x0eb,	0x0f1,	0x0f8,	0x0ff,
-  0x106,	0x10d,	0x115,	0x11c,	0x124,
-  0x12d,	0x135,	0x13f,	0x148,	0x152,
-  0x15c,	0x167,	0x172,	0x17e,	0x18b,
-  0x198,	0x1a7,	0x1b6,	0x1c6,	0x1d8,
-  0x1eb,	0x201,	0x218,	0x232,	0x250,
-  0x272,	0x29a,	0x2cc,	0x30b,	0x365,
-  0x3ff,	
-};
-
-// Sine lookup table on [0,pi/2]
-#define SINE_STEPS  101
-const float _sineLut[SINE_STEPS] PROGMEM = {
-  0.0000000,	0.0157073,	0.0314108,	0.0471065,	0.0627905,
-  0.0784591,	0.0941083,	0.1097343,	0.1253332,	0.1409012,
-  0.1564345,	0.1719291,	0.1873813,	0.2027873,	0.2181432,
-  0.2334454,	0.2486899,	0.2638730,	0.2789911,	0.2940403,
-  0.3090170,	0.3239174,	0.3387379,	0.3534748,	0.3681246,
-  0.3826834,	0.3971479,	0.4115144,	0.4257793,	0.4399392,
-  0.4539905,	0.4679298,	0.4817537,	0.4954587,	0.5090414,
-  0.5224986,	0.5358268,	0.5490228,	0.5620834,	0.5750053,
-  0.5877853,	0.6004202,	0.6129071,	0.6252427,	0.6374240,
-  0.6494480,	0.6613119,	0.6730125,	0.6845471,	0.6959128,
-  0.7071068,	0.7181263,	0.7289686,	0.7396311,	0.7501111,
-  0.7604060,	0.7705132,	0.7804304,	0.7901550,	0.7996847,
-  0.8090170,	0.8181497,	0.8270806,	0.8358074,	0.8443279,
-  0.8526402,	0.8607420,	0.8686315,	0.8763067,	0.8837656,
-  0.8910065,	0.8980276,	0.9048271,	0.9114033,	0.9177546,
-  0.9238795,	0.9297765,	0.9354440,	0.9408808,	0.9460854,
-  0.9510565,	0.9557930,	0.9602937,	0.9645574,	0.9685832,
-  0.9723699,	0.9759168,	0.9792228,	0.9822873,	0.9851093,
-  0.9876883,	0.9900237,	0.9921147,	0.9939610,	0.9955620,
-  0.9969173,	0.9980267,	0.9988899,	0.9995066,	0.9998766,
-  1.0000000	
+// Antilog percent to [0,1023] lookup table, generated at compile time
+const BrightnessLut _brightnessLut PROGMEM = makeBrightnessLut<10, AntilogCurve>();
+
+// Sine lookup table on [0,pi/2] in Q15
+// 64 steps per quadrant plus the endpoint
+#define SINE_BITS   6
+#define SINE_STEPS  ((1 << SINE_BITS) + 1)
+const int16_t _sineLut[SINE_STEPS] PROGMEM = {
+      0,	  804,	 1608,	 2410,	 3212,	 4011,	 4808,	 5602,
+   6393,	 7179,	 7962,	 8739,	 9512,	10278,	11039,	11793,
+  12539,	13279,	14010,	14732,	15446,	16151,	16846,	17530,
+  18204,	18868,	19519,	20159,	20787,	21403,	22005,	22594,
+  23170,	23731,	24279,	24811,	25329,	25832,	26319,	26790,
+  27245,	27683,	28105,	28510,	28898,	29268,	29621,	29956,
+  30273,	30571,	30852,	31113,	31356,	31580,	31785,	31971,
+  32137,	32285,	32412,	32521,	32609,	32678,	32728,	32757,
+  32767
 };
 
 Led::Led() {
@@ -63,18 +31,34 @@ Led::Led(uint8_t pin, uint8_t channel, led_style_t style){
   setPin(pin);
   setStyle(style);
 }
-#else
+#endif
+
 Led::Led(uint8_t pin, led_style_t style) {
   setPin(pin);
   setStyle(style);
 }
-#endif
+
+Led::Led(LedOutput &output, uint8_t channel, led_style_t style) {
+  setOutput(output, channel);
+  setStyle(style);
+}
 
 Led::~Led() {
+#ifdef ESP32
+  // Commands still queued for this Led must not outlive it
+  LedScheduler::getInstance().drain();
+#endif
   stop();
   manual(); // Clean up interface
+  if(_fade != nullptr) _fade->~Fade();
+  _fade = nullptr;
+  _releaseFollowers();
   setMinBrightness(0);
   off();
+
+#ifdef ESP32
+  LedcAllocator::release(_gpio.ledChannel);
+#endif
 }
 
 
@@ -90,19 +74,55 @@ Led::~Led() {
 */
 Led &Led::setPin(uint8_t pin) {
   _gpio.pin = pin;
+  _output = nullptr;
   
 #ifdef ESP32
-  ledcAttachPin(_gpio.pin, _gpio.ledChannel);
+  // Claim a channel on first use unless one was picked by hand
+  if(_gpio.ledChannel == ESPLED_NO_CHANNEL) {
+    _gpio.ledChannel = LedcAllocator::allocate(_gpio.freq, _resolution);
+    if(_gpio.ledChannel == ESPLED_NO_CHANNEL) log_e("No LEDC channel / timer left for pin %u", pin);
+  }
+  if(_gpio.ledChannel != ESPLED_NO_CHANNEL) LedBackend::attach(_gpio.ledChannel, _gpio.pin);
 #else
   pinMode(getPin(), OUTPUT);
 #endif
 
+  _duty = _DUTY_UNKNOWN;
   off();
   return *this;
 }
 
+/*
+  Sets an output to write PWM values to instead of a pin
+  @params
+    The output and its channel
+  @returns
+    void
+*/
+Led &Led::setOutput(LedOutput &output, uint8_t channel) {
+  // Hardware blinks / fades belong to the native channel, restart them in software
+  const bool restart = (_strategy != nullptr && _strategy->isStarted());
+  if(restart) _strategy->stop();
+
+#ifdef ESP32
+  // The LEDC channel is no longer needed
+  LedcAllocator::release(_gpio.ledChannel);
+  _gpio.ledChannel = ESPLED_NO_CHANNEL;
+#endif
+  _gpio.pin = ESPLED_NO_PIN;
+  _output = &output;
+  _outputChannel = channel;
+
+  _duty = _DUTY_UNKNOWN;
+  off();
+  if(restart) _strategy->start();
+  return *this;
+}
+
 Led &Led::setStyle(led_style_t style){
+  if(_post(LED_CMD_STYLE, style)) return *this;
   _gpio.style = style;
+  _reshape();
   return *this;
 }
 
@@ -115,34 +135,87 @@ Led &Led::setStyle(led_style_t style){
     uint16_t -> the value that will be sent to analogWrite
 */
 Led &Led::setMaxBrightness(uint8_t percent) {
-  _brightness.max = percent;
-  return *this;
+  return setMaxLevel( percentToLevel(percent > 100 ? 100 : percent) );
 }
 
 Led &Led::setMinBrightness(uint8_t percent){
-  _brightness.min = percent;
+  return setMinLevel( percentToLevel(percent > 100 ? 100 : percent) );
+}
+
+Led &Led::setMaxLevel(uint16_t level) {
+  if(_post(LED_CMD_MAX_LEVEL, level)) return *this;
+  _brightness.max = (level > LED_LEVEL_MAX) ? LED_LEVEL_MAX : level;
+  _reshape();
+  return *this;
+}
+
+Led &Led::setMinLevel(uint16_t level) {
+  if(_post(LED_CMD_MIN_LEVEL, level)) return *this;
+  _brightness.min = (level > LED_LEVEL_MAX) ? LED_LEVEL_MAX : level;
+  _reshape();
+  return *this;
+}
+
+Led &Led::setBrightnessLut(const BrightnessLut &lut){
+  if(_post(LED_CMD_LUT, uintptr_t(&lut))) return *this;
+  _lut = &lut;
+  _resolution = pgm_read_byte(&lut.bits);
+  _range = (1UL << _resolution) - 1;
+
+#ifdef ESP32
+  _retime();
+#else
+  analogWriteRange(_range);
+#endif
+
+  _duty = _DUTY_UNKNOWN;
+  _reshape();
+  return *this;
 }
 
 Led &Led::manual(){
+  _unsync();
+  _stopFade();
   if(_strategy == nullptr) return *this;
 
+  // Strategy lives in _storage, destroy it in place
   _strategy->stop();
-  delete _strategy;
+  _strategy->~LedInterface();
   _strategy = nullptr;
   return *this;
 }
 
 #ifdef ESP32
 Led &Led::setChannel(uint8_t chan){
-  _gpio.ledChannel = chan;
-  ledcSetup(_gpio.ledChannel, _gpio.freq, _gpio.resolution);
+  if(chan == _gpio.ledChannel) return *this;
+
+  LedcAllocator::release(_gpio.ledChannel);
+  if(LedcAllocator::claim(chan, _gpio.freq, _resolution)) {
+    _gpio.ledChannel = chan;
+    if(_gpio.pin != ESPLED_NO_PIN) LedBackend::attach(_gpio.ledChannel, _gpio.pin);
+  }
+  else {
+    _gpio.ledChannel = ESPLED_NO_CHANNEL;
+    log_e("LEDC channel %u is taken or has no timer left", chan);
+  }
+
+  _duty = _DUTY_UNKNOWN;
   return *this;
 }
 
 Led &Led::setFrequency(unsigned long hz){
   _gpio.freq = hz;
+  _retime();
   return *this;
 }
+
+void Led::_retime(){
+  if(_gpio.ledChannel == ESPLED_NO_CHANNEL) return;
+  if(!LedcAllocator::retime(_gpio.ledChannel, _gpio.freq, _resolution)) {
+    log_e("No LEDC timer left for %u Hz at %u bits", _gpio.freq, _resolution);
+  }
+  _duty = _DUTY_UNKNOWN;
+}
 #endif
 
 
@@ -157,34 +230,74 @@ Led &Led::setFrequency(unsigned long hz){
 */
 Led &Led::setPeriod(unsigned long ms){
   // Remember period is [0,2pi] because wave is offset to always be positive
-  _step_rads = TWO_PI / ms * hzToMs( getRefreshRate() );
+  // Phase advances once per refresh, which lasts hzToUs() us
+  // Periods shorter than two refreshes are clamped to a half turn per step
+  if(ms == 0) return *this;
+  if(_post(LED_CMD_PERIOD, ms)) return *this;
+  const uint64_t turn_us = (uint64_t(1) << 32) * hzToUs( getRefreshRate() );
+  const uint64_t period_us = uint64_t(ms) * 1000;
+  const uint64_t step = (turn_us + period_us / 2) / period_us;
+  _phaseStep = (step > 0x80000000) ? 0x80000000 : step;
+  _reshape();
   return *this;
 }
 
 Led &Led::setTheta(float radians){
   if(radians >= TWO_PI) { radians = 0; }
   radians = constrain(radians, 0, TWO_PI);
-  _theta_rads = radians;
-  return *this;
+  return setPhase(radsToPhase(radians));
 }
 
 Led &Led::setDeltaTheta(float radians){
-  _step_rads = abs(radians);
+  return setPhaseStep(radsToPhase(abs(radians)));
+}
+
+Led &Led::setPhase(uint32_t phase){
+  if(_post(LED_CMD_PHASE, phase)) return *this;
+  _phase = phase;
+  _reshape();
+  return *this;
+}
+
+Led &Led::setPhaseStep(uint32_t step){
+  if(_post(LED_CMD_PHASE_STEP, step)) return *this;
+  _phaseStep = step;
+  _reshape();
   return *this;
 }
 
 Led &Led::setRefreshRate(unsigned int hz){
+  if(hz == 0) return *this;
+  if(_post(LED_CMD_REFRESH_RATE, hz)) return *this;
+
+  // Rescale the step so the period in ms stays the same
+  const unsigned long period_ms = getPeriod();
   _refreshRate_hz = hz;
+  return setPeriod(period_ms);
+}
+
+Led &Led::setTransition(unsigned long ms){
+  if(_post(LED_CMD_TRANSITION, ms)) return *this;
+  _transition_ms = ms;
   return *this;
 }
 
+/*
+  Functions to pick a mode
+  Modes start from off, unless a transition is set in which case the
+  output holds until start() crossfades it into the mode
+*/
 Led &Led::pulse(){
-  if(_strategy != nullptr) {
-    _strategy->stop(); 
-    delete _strategy; 
-  }
-  off();
-  _strategy = new Pulse(*this);
+  manual();
+  if(!_transition_ms) off();
+  _strategy = new (_storage) Pulse(*this);
+  return *this;
+}
+
+Led &Led::hardwarePulse(){
+  manual();
+  if(!_transition_ms) off();
+  _strategy = new (_storage) HardwarePulse(*this);
   return *this;
 }
 
@@ -204,29 +317,52 @@ Led &Led::pulse(){
     void	
 */
 Led &Led::setInterval(unsigned long ms) {
+  if(_post(LED_CMD_INTERVAL, ms)) return *this;
   _interval_ms = ms;
+  _reshape();
   return *this;
 }
 
 Led &Led::setDuration(unsigned long ms) {
+  if(_post(LED_CMD_DURATION, ms)) return *this;
   _duration_ms = ms;
+  _reshape();
   return *this;
 }
 
 Led &Led::blink(){
-  if(_strategy != nullptr) { 
-    _strategy->stop();
-    delete _strategy; 
-  }
-  off();
-  _strategy = new Blink(*this);
+  manual();
+  if(!_transition_ms) off();
+  _strategy = new (_storage) Blink(*this);
+  return *this;
+}
+
+Led &Led::keyframes(const KeyframeTable &table){
+  manual();
+  if(!_transition_ms) off();
+  _strategy = new (_storage) Keyframes(*this, table);
+  return *this;
+}
+
+Led &Led::sequence(const uint8_t *pattern){
+  manual();
+  if(!_transition_ms) off();
+  _strategy = new (_storage) Sequence(*this, pattern);
+  return *this;
+}
+
+Led &Led::stream(LedSamples &samples, stream_mode_t mode, uint8_t smoothing){
+  manual();
+  if(!_transition_ms) off();
+  _strategy = new (_storage) SampleStream(*this, samples, mode, smoothing);
   return *this;
 }
 
 
 unsigned long Led::getPeriod() {
-  const float stepsPerPeriod = TWO_PI / getDeltaTheta();
-  return stepsPerPeriod / getRefreshRate() * 1000;  // seconds to ms
+  if(_phaseStep == 0) return 0;
+  const uint64_t turn_us = (uint64_t(1) << 32) * hzToUs( getRefreshRate() );
+  return ((turn_us + _phaseStep / 2) / _phaseStep + 500) / 1000;
 }
 
 
@@ -243,30 +379,52 @@ unsigned long Led::getPeriod() {
     void
 */
 Led &Led::on(){
-  return on( getMaxBrightness() );
+  return onLevel( getMaxLevel() );
 }
 
 Led &Led::on(uint8_t percent) {
+  return onLevel( percentToLevel(percent > 100 ? 100 : percent) );
+}
+
+Led &Led::onLevel(uint16_t level) {
+  if(_post(LED_CMD_ON_LEVEL, level)) return *this;
+  _stopFade();
   _isOn = true;
-  percent = constrain(percent, getMinBrightness(), getMaxBrightness());
-#ifdef ESP32
-  ledcWrite(getChannel(), _mapToAnalog(percent));
-#else
-  analogWrite( getPin(), _mapToAnalog(percent) );
-#endif
+  level = constrain(level, getMinLevel(), getMaxLevel());
+  _write( _mapToAnalog(level) );
   return *this;
 }
 
 Led &Led::off() {
+  if(_post(LED_CMD_OFF, 0)) return *this;
+  _stopFade();
   _isOn = false;
-#ifdef ESP32
-  ledcWrite( getChannel(), _mapToAnalog(getMinBrightness()) );
-#else
-  analogWrite( getPin(), _mapToAnalog(getMinBrightness()) );
-#endif
+  _write( _mapToAnalog(getMinLevel()) );
+  return *this;
+}
+
+Led &Led::on(uint8_t percent, unsigned long fade_ms) {
+  return onLevel( percentToLevel(percent > 100 ? 100 : percent), fade_ms );
+}
+
+Led &Led::onLevel(uint16_t level, unsigned long fade_ms) {
+  if(_post(LED_CMD_FADE_ON, level, fade_ms)) return *this;
+  manual();
+  _fadeTo(constrain(level, getMinLevel(), getMaxLevel()), fade_ms, true, nullptr);
   return *this;
 }
 
+Led &Led::off(unsigned long fade_ms) {
+  if(_post(LED_CMD_FADE_OFF, fade_ms)) return *this;
+  manual();
+  _fadeTo(getMinLevel(), fade_ms, false, nullptr);
+  return *this;
+}
+
+bool Led::isFading() {
+  return _fade != nullptr && _fade->isStarted();
+}
+
 Led &Led::toggle(){
   return toggle(getMaxBrightness());
 }
@@ -278,28 +436,145 @@ Led &Led::toggle(uint8_t power) {
 
 /*
   Function to sync the actions of two Leds
-  Does not adjust timings, just makes them start at the same time by calling setMode()
+  The follower gives up its own interface and is driven from the master's
+  Pulse tick, so any number of synced Leds share one timer and never drift
   @params
-    Pointer to the Led object to sync to
+    Led to sync to, phase offset from the master, one full turn = 2^32
   @returns
     void	
 */
-// void Led::sync(Led &master){
-//   this->stop();
-//   master.stop();
+Led &Led::sync(Led &master, uint32_t phaseOffset){
+
+  // Followers of followers are attached to the root master
+  Led *root = &master;
+  while(root->_master != nullptr) {
+    phaseOffset += root->_syncOffset;
+    root = root->_master;
+  }
+  if(root == this) return *this;
+
+  manual();
+  off();
+
+  LedScheduler &scheduler = LedScheduler::getInstance();
+  scheduler._lockHeap();
+
+  // Anything following this Led moves over to the root master
+  while(_followers != nullptr) {
+    Led *follower = _followers;
+    _followers = follower->_nextFollower;
+    follower->_syncOffset += phaseOffset;
+    follower->_master = root;
+    follower->_nextFollower = root->_followers;
+    root->_followers = follower;
+  }
+
+  _master = root;
+  _syncOffset = phaseOffset;
+  _nextFollower = root->_followers;
+  root->_followers = this;
+
+  scheduler._unlockHeap();
+
+  // Let a running master pick up its new follower right away
+  if(root->_strategy != nullptr) root->_strategy->_reshape();
+  return *this;
+}
+
+void Led::_unsync(){
+  if(_master == nullptr) return;
+
+  LedScheduler &scheduler = LedScheduler::getInstance();
+  scheduler._lockHeap();
+
+  Led **link = &_master->_followers;
+  while(*link != nullptr && *link != this) link = &(*link)->_nextFollower;
+  if(*link == this) *link = _nextFollower;
+  _master = nullptr;
+  _nextFollower = nullptr;
+
+  scheduler._unlockHeap();
+}
+
+void Led::_releaseFollowers(){
+  LedScheduler &scheduler = LedScheduler::getInstance();
+  scheduler._lockHeap();
+
+  while(_followers != nullptr) {
+    Led *follower = _followers;
+    _followers = follower->_nextFollower;
+    follower->_master = nullptr;
+    follower->_nextFollower = nullptr;
+  }
+
+  scheduler._unlockHeap();
+}
 
-// }
 
 
+/*
+  Functions to hand setter calls to the scheduler
+  On ESP32 a Led being animated is only changed by the scheduler task, calls
+  from other tasks are queued and applied before its next tick. Calls from
+  an ISR are always queued, whether the Led is animated or not
+  @params
+    Command and its argument
+  @returns
+    _post() -> true if the command was queued rather than to be applied now
+*/
+bool Led::_post(uint8_t op, uintptr_t value, uint32_t arg){
+#ifdef ESP32
+  if(xPortInIsrContext()) return LedScheduler::getInstance().post(this, op, value, arg);
+
+  const bool animated = (_strategy != nullptr && _strategy->isStarted()) || _master != nullptr || isFading();
+  return animated && LedScheduler::getInstance().post(this, op, value, arg);
+#else
+  // Ticker callbacks never preempt loop(), so setters always apply directly
+  (void)op;
+  (void)value;
+  (void)arg;
+  return false;
+#endif
+}
+
+void Led::_apply(uint8_t op, uintptr_t value, uint32_t arg){
+  switch(op) {
+    case LED_CMD_MAX_LEVEL:     setMaxLevel(value); break;
+    case LED_CMD_MIN_LEVEL:     setMinLevel(value); break;
+    case LED_CMD_PERIOD:        setPeriod(value); break;
+    case LED_CMD_PHASE:         setPhase(value); break;
+    case LED_CMD_PHASE_STEP:    setPhaseStep(value); break;
+    case LED_CMD_REFRESH_RATE:  setRefreshRate(value); break;
+    case LED_CMD_INTERVAL:      setInterval(value); break;
+    case LED_CMD_DURATION:      setDuration(value); break;
+    case LED_CMD_ON_LEVEL:      onLevel(value); break;
+    case LED_CMD_OFF:           off(); break;
+    case LED_CMD_FADE_ON:       onLevel(value, arg); break;
+    case LED_CMD_FADE_OFF:      off(value); break;
+    case LED_CMD_STYLE:         setStyle(led_style_t(value)); break;
+    case LED_CMD_LUT:           setBrightnessLut(*(const BrightnessLut *)value); break;
+    case LED_CMD_TRANSITION:    setTransition(value); break;
+  }
+}
 
 Led &Led::start() {
-  if(_strategy != nullptr){
-    _strategy->start();
+  if(_strategy == nullptr || _strategy->isStarted()) return *this;
+
+  // Crossfade into the first frame, the fade starts the strategy when done
+  if(_transition_ms && _master == nullptr) {
+    if(!isFading()) _fadeTo(_strategy->_firstLevel(), _transition_ms, true, _strategy);
+    return *this;
   }
+  _strategy->start();
   return *this;
 }
 
+bool Led::isStarted() {
+  return (_strategy != nullptr && _strategy->isStarted()) || isFading();
+}
+
 Led &Led::stop() {
+  _stopFade();
   if(_strategy != nullptr){
     _strategy->stop();
   }
@@ -310,40 +585,113 @@ Led &Led::stop() {
 
 
 
-uint16_t Led::_mapToAnalog(uint8_t percent){
-  const uint16_t ret = pgm_read_word(_brightnessLut + percent);
-  return (getStyle() == REG) ? ret : PWMRANGE - ret;
+/*
+  Functions for fades
+  @params
+    Target level, fade time, whether the Led ends on and what to start after
+  @returns
+    _currentLevel() -> the lowest level mapping onto the current output
+*/
+void Led::_fadeTo(uint16_t level, unsigned long fade_ms, bool on, LedInterface *next){
+  if(_fade == nullptr) _fade = new (_fadeStorage) Fade(*this);
+  _fade->stop();
+  _fade->begin(level, fade_ms, on, next);
+}
+
+void Led::_stopFade(){
+  // Setters on an idle Led must not wait for the scheduler lock
+  if(_fade != nullptr && _fade->isStarted()) _fade->stop();
+}
+
+uint16_t Led::_currentLevel(){
+  if(_duty == _DUTY_UNKNOWN) return _isOn ? getMaxLevel() : getMinLevel();
+
+  // Brightness only ever rises with level, search it in PWM terms made style independent
+  const bool reg = (getStyle() == REG);
+  const uint16_t target = reg ? _duty : _range - _duty;
+  uint16_t lo = 0, hi = LED_LEVEL_MAX;
+  while(lo < hi) {
+    const uint16_t mid = (lo + hi) / 2;
+    const uint16_t duty = _mapToAnalog(mid);
+    if((reg ? duty : _range - duty) < target) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+uint16_t Led::_mapToAnalog(uint16_t level){
+  const uint8_t index = level / LED_LEVELS_PER_PERCENT;
+  uint16_t ret = pgm_read_word(_lut->value + index);
+
+  // Interpolate between table entries, exact on whole percents
+  const uint16_t frac = level % LED_LEVELS_PER_PERCENT;
+  if(frac && index < BRIGHTNESS_STEPS - 1) {
+    const uint16_t next = pgm_read_word(_lut->value + index + 1);
+    ret += (uint32_t(next - ret) * frac + LED_LEVELS_PER_PERCENT / 2) / LED_LEVELS_PER_PERCENT;
+  }
+
+  return (getStyle() == REG) ? ret : _range - ret;
+}
+
+void Led::_reshape(){
+  _revision++;
+  if(_strategy != nullptr) _strategy->_reshape();
+
+  // Followers are rendered by their master's interface
+  if(_master != nullptr && _master->_strategy != nullptr) _master->_strategy->_reshape();
 }
 
-float Pulse::_mapToSine(float theta){
+uint8_t Led::_channel(){
+  if(_output != nullptr) return _outputChannel;
+#ifdef ESP32
+  return getChannel();
+#else
+  return getPin();
+#endif
+}
 
-  int index = 0;
-  int sign = 1;
-  const int elements = SINE_STEPS - 1;
+void Led::_write(uint16_t duty){
+  if(duty == _duty) return;
+  _duty = duty;
+
+  if(_output != nullptr) {
+    _output->write(_outputChannel, duty, _resolution);
+    return;
+  }
+
+#ifdef ESP32
+  if(_gpio.ledChannel != ESPLED_NO_CHANNEL) LedBackend::write(_gpio.ledChannel, duty, _resolution);
+#else
+  analogWrite( getPin(), duty );
+#endif
+}
+
+int16_t Pulse::_mapToSine(uint32_t phase){
 
   /*
     Use a sine lookup table from [0,pi/2] to find sine on
     [0,2pi]
+    Top 2 bits of phase give the quadrant, the next SINE_BITS the
+    table index and the following 8 bits interpolate between entries
   */
-
-  // Quadrant 3
-  if(theta >= 3 * HALF_PI && theta < TWO_PI){
-    index = -1 * elements;
-    sign = -1;
-  }
-  // Quadrant 2
-  else if(theta > PI) {
-    sign = -1;
+  const uint8_t quadrant = phase >> 30;
+  uint16_t index = (phase >> (30 - SINE_BITS)) & ((1 << SINE_BITS) - 1);
+  const int32_t frac = (phase >> (22 - SINE_BITS)) & 0xFF;
+
+  // Quadrants 1 and 3 run backwards through the table
+  int32_t a, b;
+  if(quadrant & 1) {
+    index = (1 << SINE_BITS) - index;
+    a = (int16_t)pgm_read_word(_sineLut + index);
+    b = (int16_t)pgm_read_word(_sineLut + index - 1);
   }
-  // Quadrant 1
-  else if(theta > HALF_PI ) {
-    index = -1 * elements;
+  else {
+    a = (int16_t)pgm_read_word(_sineLut + index);
+    b = (int16_t)pgm_read_word(_sineLut + index + 1);
   }
 
-  index = abs(index + int(elements * theta / HALF_PI) % elements);
-  float ret = sign * pgm_read_float_near(_sineLut + index);
-
-  return ret; 
+  const int16_t ret = a + (((b - a) * frac) >> 8);
+  return (quadrant & 2) ? -ret : ret; 
 }
 
 
@@ -353,49 +701,27 @@ float Pulse::_mapToSine(float theta){
 
 
 
-void Blink::_setupTimer(){
+/*
+  Functions to start and stop the interface
+  All interfaces share the timer of LedScheduler
+  @params
+    void
+  @returns
+    void
+*/
+void LedInterface::start(){
+  if(isStarted()) return;
+  _started = LedScheduler::getInstance().add(this);
 #ifdef ESP32
-  
-  // Create a new task
-  xTaskCreate(
-    _tickerWrap,    // Function
-    "Led Task",     // Name
-    1000,           // Stack size in words
-    (void*)this,    // Parameter
-    1,              // Task priority
-    &_taskHandle    // Task handle
-  );
-
-#else
-  _handle(); 
+  // Banks and other interfaces without a Led have no pin to report
+  if(!_started && _led) log_e("No memory to schedule Led on pin %u", _led->getPin());
+  else if(!_started) log_e("No memory to schedule interface");
 #endif
 }
 
-void Pulse::_setupTimer(){
-  #ifdef ESP32
-    
-  xTaskCreate(
-    _tickerWrap,    // Function
-    "Led Task",     // Name
-    1000,           // Stack size in words
-    (void*)this,    // Parameter
-    1,              // Task priority
-    &_taskHandle    // Task handle
-  );
-  
-  #else
-    _handle();
-  #endif
-  }
-
-
 void LedInterface::stop(){
-#ifdef ESP32
-  Serial.println("Deleting task");
-  vTaskDelete(_taskHandle);
-#else
-  _tick.detach();
-#endif
+  _started = false;
+  LedScheduler::getInstance().remove(this);
 }
 
 
@@ -415,30 +741,83 @@ void LedInterface::stop(){
     void	
 */
 
-unsigned long Blink::_handle() {
+uint64_t Blink::_handle() {
   _led->toggle();
   const unsigned long waitTime = _led->isOn() ? _led->getDuration() : _led->getInterval(); 
+  return uint64_t(waitTime) * 1000;
+}
+
+void Blink::start(){
+  if(isStarted()) return;
+
+  // A blinking PWM unit needs no timer at all
+  if(_startHardware()) {
+    _hardware = true;
+    _started = true;
+    return;
+  }
+  LedInterface::start();
+}
 
-#ifndef ESP32
-  _tick.once_ms(waitTime, _tickerWrap, (void *)this);
+void Blink::stop(){
+  if(!_hardware) {
+    LedInterface::stop();
+    return;
+  }
+
+  // Put the channel back to normal PWM, its duty is still the blink's
+  _hardware = false;
+  _started = false;
+#ifdef ESP32
+  _led->_retime();
+#else
+  _led->_duty = Led::_DUTY_UNKNOWN;
 #endif
+  _led->off();
+}
 
-  return waitTime;
+void Blink::_reshape(){
+  if(!isStarted()) return;
+  stop();
+  start();
 }
 
-void Blink::_tickerWrap(void *ptr){
-  Blink *self = (Blink *)ptr;
+/*
+  The PWM unit can only produce fully on and fully off, so a hardware blink
+  needs a brightness range covering the whole PWM range
+  With INVERTED Leds the high part of each cycle is the interval
+*/
+bool Blink::_startHardware(){
+  if(_led->getOutput() != nullptr) return false;
+
+  uint32_t clock_hz;
+  uint8_t maxBits;
+  if(!LedBackend::blinkLimits(clock_hz, maxBits)) return false;
+
+  const bool reg = (_led->getStyle() == REG);
+  if(_led->_mapToAnalog(_led->getMaxLevel()) != (reg ? _led->_range : 0)) return false;
+  if(_led->_mapToAnalog(_led->getMinLevel()) != (reg ? 0 : _led->_range)) return false;
+
+  const unsigned long period_ms = _led->getDuration() + _led->getInterval();
+  const unsigned long high_ms = reg ? _led->getDuration() : _led->getInterval();
+
+  PwmBlink config;
+  if(!LedBackend::blinkConfig(period_ms, high_ms, clock_hz, maxBits, config)) return false;
 
 #ifdef ESP32
-  TickType_t xLastWakeTime = xTaskGetTickCount(); // Initialize for delayUntil
-  
-  while(true){
-    const TickType_t xFrequency = self->_handle() / portTICK_PERIOD_MS;
-    vTaskDelayUntil(&xLastWakeTime, xFrequency);
+  // The blink reprograms its timer, so it cannot share one
+  if(!LedcAllocator::retime(_led->_channel(), ESPLED_TIMER_EXCLUSIVE, 0)) return false;
+  if(!LedBackend::blink(_led->_channel(), config)) {
+    _led->_retime();
+    return false;
   }
 #else
-  self->_handle();
+  if(!LedBackend::blink(_led->_channel(), config)) return false;
 #endif
+
+  _led->_duty = Led::_DUTY_UNKNOWN;
+  _led->_isOn = true;
+  return true;
 }
 
 
@@ -446,54 +825,512 @@ void Blink::_tickerWrap(void *ptr){
 
 
 
+void Pulse::start(){
+  if(isStarted()) return;
+  _synced = false;
+  LedInterface::start();
+}
 
+uint64_t Pulse::_handle() {
+  const unsigned long now = LedClock::now();
+
+  // Settings changed since the last tick, restart the time base
+  if(!_synced || _revision != _led->_revision) _sync(now);
+
+  const uint32_t phase = _phaseAt(now);
+  _led->_phase = _published = phase;
+
+  uint16_t duty;
+  uint32_t wait_us;
+
+  if(_frames != nullptr) {
+    // Walk forward to the run holding the current frame
+    // Late ticks simply skip runs, wrapping at the end of the period
+    const uint16_t count = _frames->getCount();
+    const uint16_t frame = (uint64_t(phase) * count) >> 32;
+    while(frame < _runStart || frame >= _runStart + _frames->run[_run].frames) {
+      _runStart += _frames->run[_run].frames;
+      if(++_run >= _frames->getRuns()) { _run = 0; _runStart = 0; }
+    }
+    duty = _frames->run[_run].duty;
+
+    // Sleep until the phase reaches the first frame of the next run
+    const uint64_t runEnd = _runStart + _frames->run[_run].frames;
+    const uint64_t target = ((runEnd << 32) + count - 1) / count;
+    wait_us = _timeTo(uint32_t(phase - _offset) + (target - phase), now);
+  }
+  else {
+    wait_us = _renderLive(*_led, 0, phase, now, duty);
+  }
 
+  // Led only writes when the output changes
+  _led->_isOn = true;
+  _led->_write(duty);
 
+  // Synced Leds run off the same time base in the same tick
+  // The pulse wakes for whichever Led changes first
+  for(Led *follower = _led->_followers; follower != nullptr; follower = follower->_nextFollower) {
+    uint16_t followerDuty;
+    const uint32_t followerWait_us = _renderLive(*follower, follower->_syncOffset, phase, now, followerDuty);
+    if(followerWait_us < wait_us) wait_us = followerWait_us;
 
-unsigned long Pulse::_handle() {
+    follower->_phase = phase + follower->_syncOffset;
+    follower->_isOn = true;
+    follower->_write(followerDuty);
+  }
+
+  // Sleep until the output next changes
+  return _fromNow(wait_us);
+}
+
+void Pulse::_reshape(){
+  if(isStarted()) LedScheduler::getInstance().add(this);
+}
 
-  const float sine_old = _mapToSine(_led->getTheta());
-  _led->setTheta(_led->getTheta() + _led->getDeltaTheta());
-  const float sine = _mapToSine(_led->getTheta());
 
-  
-  // Calculate amplitude and offset for a sine wave between max and min
-  const uint8_t offset = (_led->getMaxBrightness() + _led->getMinBrightness()) / 2;
-  const uint8_t amplitude = _led->getMaxBrightness() - offset;
 
-  if( uint8_t(amplitude * sine_old) != uint8_t(amplitude * sine)) {
 
-    // Increment theta by delta theta
-    // Constraint to [0, 2PI) happens in setTheta()
-    
-  
-    // Calculate brightness using a sine wave
-    
-    const uint8_t outputWave = amplitude * sine + offset;
 
-    // And turn the LED on using the percent brightness
-    _led->on(outputWave);
+
+void HardwarePulse::start(){
+  if(isStarted()) return;
+  _rising = true;
+  _software = false;
+  Pulse::start();
+}
+
+void HardwarePulse::stop(){
+  if(isStarted() && !_software) {
+    LedBackend::stopFade(_led->_channel());
   }
+  Pulse::stop();
+}
 
-  // Schedule next update
-#ifndef ESP32
-  _tick.once_ms(hzToMs(_led->getRefreshRate()), _tickerWrap, (void *)this);
-#endif
-  return _led->getRefreshRate();
+/*
+  Alternates fades up to max and down to min brightness, each lasting half
+  a period. Waits are returned as is, like Blink, so the fades stay locked
+  to the period however late the task runs.
+  Synced Leds need every tick to be rendered, so a master with followers
+  pulses in software.
+*/
+uint64_t HardwarePulse::_handle() {
+  const unsigned long half_ms = _led->getPeriod() / 2;
+
+  if(!_software && (half_ms == 0 || _led->_followers != nullptr || _led->_output != nullptr || !LedBackend::hasFade())) {
+    _software = true;
+  }
+  if(_software) return Pulse::_handle();
+
+  const uint16_t target = _led->_mapToAnalog(_rising ? _led->getMaxLevel() : _led->getMinLevel());
+  if(!LedBackend::fade(_led->_channel(), target, half_ms)) {
+    _software = true;
+    return Pulse::_handle();
+  }
+
+  // Hardware now owns the duty, force the next manual write through
+  _led->_isOn = true;
+  _led->_duty = Led::_DUTY_UNKNOWN;
+  _rising = !_rising;
+  return uint64_t(half_ms) * 1000;
 }
 
-void Pulse::_tickerWrap(void* ptr){
-  Pulse *self = (Pulse *)ptr;
-#ifdef ESP32
-  TickType_t xLastWakeTime = xTaskGetTickCount();
-  
-  while(true){
-    const TickType_t xFrequency = self->_handle() / portTICK_PERIOD_MS;
-    vTaskDelayUntil(&xLastWakeTime, xFrequency);
+void HardwarePulse::_reshape(){
+  if(!_software) {
+    _rising = true;
+    if(isStarted()) LedScheduler::getInstance().add(this);
   }
-#else
-  self->_handle();
-#endif
+  else {
+    Pulse::_reshape();
+  }
+}
+
+
+
+
+
+
+void Keyframes::start(){
+  if(isStarted()) return;
+  _synced = false;
+  LedInterface::start();
 }
 
+uint64_t Keyframes::_handle() {
+  const unsigned long now = LedClock::now() / 1000;
+  const uint16_t period = _table->getPeriod();
+
+  if(!_table->isValid()) {
+    stop();
+    return 0;
+  }
+
+  if(!_synced) {
+    _epoch_ms = now;
+    _segment = 0;
+    _synced = true;
+  }
+
+  // Rebase the epoch by whole loops so timing never drifts
+  unsigned long elapsed = now - _epoch_ms;
+  const bool finished = !_table->isLoop() && elapsed >= period;
+  if(elapsed >= period && !finished) {
+    const unsigned long loops = elapsed / period;
+    _epoch_ms += loops * period;
+    elapsed -= loops * period;
+  }
+
+  const uint16_t level = _toLevel(_table->levelAt(finished ? period : elapsed, _segment));
+
+  _led->_isOn = level > _led->getMinLevel();
+  _led->_write(_led->_mapToAnalog(level));
+
+  // Hold the final keyframe once a single shot animation ends
+  if(finished) {
+    stop();
+    return 0;
+  }
+
+  // Flat segments sleep through, others refresh at the Led's refresh rate
+  const uint64_t untilEnd = uint64_t(_table->endOf(_segment) - elapsed) * 1000;
+  const uint64_t refresh = hzToUs( _led->getRefreshRate() ) ? hzToUs( _led->getRefreshRate() ) : 1;
+  const uint64_t wait = (_table->isFlat(_segment) || refresh > untilEnd) ? untilEnd : refresh;
+  return _fromNow(wait);
+}
+
+void Keyframes::_reshape(){
+  if(isStarted()) LedScheduler::getInstance().add(this);
+}
+
+uint16_t Keyframes::_firstLevel(){
+  uint8_t segment = 0;
+  return _table->isValid() ? _toLevel(_table->levelAt(0, segment)) : _led->getMinLevel();
+}
+
+// Keyframes are relative to the Led's brightness range
+uint16_t Keyframes::_toLevel(uint16_t rel){
+  const uint16_t min = _led->getMinLevel();
+  const uint16_t max = _led->getMaxLevel();
+  const uint32_t span = (max > min) ? max - min : 0;
+  return min + (span * rel + LED_LEVEL_MAX / 2) / LED_LEVEL_MAX;
+}
+
+
 
+
+
+
+/*
+  Fades one refresh at a time, the level is interpolated from the time
+  elapsed so late ticks catch up rather than stretch the fade
+*/
+void Fade::begin(uint16_t level, unsigned long fade_ms, bool on, LedInterface *next){
+  _from = _led->_currentLevel();
+  _to = level;
+  _on = on;
+  _next = next;
+  _start_us = LedClock::now();
+  _duration_us = fade_ms * 1000;
+
+  if(_duration_us == 0 || _from == _to) {
+    _finish();
+    return;
+  }
+  LedInterface::start();
+}
+
+uint64_t Fade::_handle(){
+  const uint64_t elapsed = LedClock::now() - _start_us;
+  if(elapsed >= _duration_us) {
+    _finish();
+    return 0;
+  }
+
+  const int32_t delta = int32_t(_to) - int32_t(_from);
+  const uint16_t level = _from + int32_t((int64_t(delta) * int64_t(elapsed)) / int64_t(_duration_us));
+  _led->_isOn = true;
+  _led->_write(_led->_mapToAnalog(level));
+
+  // Refresh at the Led's rate, ending exactly on time
+  const uint64_t refresh = hzToUs( _led->getRefreshRate() ) ? hzToUs( _led->getRefreshRate() ) : 1;
+  const uint64_t remaining = _duration_us - elapsed;
+  return _fromNow((refresh < remaining) ? refresh : remaining);
+}
+
+void Fade::_finish(){
+  stop();
+  _led->_write(_led->_mapToAnalog(_to));
+  _led->_isOn = _on;
+
+  if(_next != nullptr) {
+    // Modes start from the off state, as they would after off()
+    _led->_isOn = false;
+    _next->start();
+  }
+}
+
+void Sequence::start(){
+  if(isStarted()) return;
+  _pc = 0;
+  _depth = 0;
+  LedInterface::start();
+}
+
+/*
+  Each tick runs instructions until one takes time, waits are returned
+  as is so the deadline advances exactly like Blink and never drifts
+*/
+uint64_t Sequence::_handle() {
+  for(uint8_t steps = 0; steps < ESPLED_SEQUENCE_STEPS; steps++) {
+    const uint8_t op = pgm_read_byte(_pattern + _pc++);
+
+    switch(op) {
+      case SEQ_OP_ON:
+        _led->on();
+        break;
+
+      case SEQ_OP_OFF:
+        _led->off();
+        break;
+
+      case SEQ_OP_LEVEL:
+        _led->on(pgm_read_byte(_pattern + _pc++));
+        break;
+
+      case SEQ_OP_WAIT: {
+        const uint16_t wait = (pgm_read_byte(_pattern + _pc) << 8) | pgm_read_byte(_pattern + _pc + 1);
+        _pc += 2;
+        if(wait > 0) return uint64_t(wait) * 1000;
+        break;
+      }
+
+      case SEQ_OP_REPEAT: {
+        const uint8_t count = pgm_read_byte(_pattern + _pc++);
+        if(_depth < ESPLED_SEQUENCE_DEPTH) {
+          _loops[_depth].start = _pc;
+          _loops[_depth].remaining = count ? count - 1 : 0;
+        }
+        _depth++;
+        break;
+      }
+
+      case SEQ_OP_NEXT:
+        if(_depth == 0) break;
+        if(_depth <= ESPLED_SEQUENCE_DEPTH && _loops[_depth - 1].remaining > 0) {
+          _loops[_depth - 1].remaining--;
+          _pc = _loops[_depth - 1].start;
+        }
+        else {
+          _depth--;
+        }
+        break;
+
+      case SEQ_OP_LOOP:
+        _pc = 0;
+        _depth = 0;
+        break;
+
+      default:
+        // SEQ_OP_END or an unknown opcode
+        _led->off();
+        stop();
+        return 0;
+    }
+  }
+
+  // Pattern has not waited in a while, yield to the rest of the system
+  return 1000;
+}
+
+void SampleStream::start(){
+  if(isStarted()) return;
+
+  // Carry on from the current output, relative to the range
+  const uint16_t min = _led->getMinLevel();
+  const uint16_t max = _led->getMaxLevel();
+  const uint16_t level = _led->_currentLevel();
+  _level = (max > min && level > min) ? (uint32_t(level - min) * LED_LEVEL_MAX / (max - min)) << 8 : 0;
+  if(_level > uint32_t(LED_LEVEL_MAX) << 8) _level = uint32_t(LED_LEVEL_MAX) << 8;
+  LedInterface::start();
+}
+
+/*
+  Each refresh reduces the samples that arrived since the last one to a
+  single target, then moves the output towards it by the smoothing. A
+  producer faster than the refresh rate is decimated, a slower one is
+  held, or eased towards when smoothing is set. Waits are returned as is
+  so refreshes keep an exact cadence.
+*/
+uint64_t SampleStream::_handle(){
+  uint32_t sum = 0;
+  uint16_t count = 0;
+  uint16_t peak = 0;
+  uint16_t sample = 0;
+  // Bounded so a producer pushing flat out cannot hold the tick
+  while(count < ESPLED_STREAM_SAMPLES && _samples->pop(sample)) {
+    if(sample > LED_LEVEL_MAX) sample = LED_LEVEL_MAX;
+    sum += sample;
+    if(sample > peak) peak = sample;
+    count++;
+  }
+  _read += count;
+
+  const uint32_t current = _level;
+  uint32_t target = current;
+  if(count == 0) {
+    _starved++;
+  }
+  else if(_mode == STREAM_AVERAGE) {
+    target = ((sum << 8) + count / 2) / count;
+  }
+  else if(_mode == STREAM_PEAK) {
+    target = uint32_t(peak) << 8;
+  }
+  else {
+    target = uint32_t(sample) << 8;
+  }
+
+  // One pole low pass, peaks jump up at once and only decay smoothly
+  if(_mode == STREAM_PEAK && target >= current) {
+    _level = target;
+  }
+  else {
+    _level = (current * _smoothing + target * (256 - _smoothing)) >> 8;
+  }
+
+  // Samples are relative to the Led's brightness range
+  const uint16_t min = _led->getMinLevel();
+  const uint16_t max = _led->getMaxLevel();
+  const uint32_t span = (max > min) ? max - min : 0;
+  const uint16_t level = min + (span * (_level >> 8) + LED_LEVEL_MAX / 2) / LED_LEVEL_MAX;
+
+  _led->_isOn = level > min;
+  _led->_write(_led->_mapToAnalog(level));
+
+  const unsigned long refresh = hzToUs( _led->getRefreshRate() );
+  return refresh ? refresh : 1;
+}
+
+uint32_t Pulse::_renderLive(Led &led, uint32_t shift, uint32_t phase, unsigned long now_us, uint16_t &duty){
+
+  // Look ahead for the next refresh where the brightness changes
+  const uint16_t min = led.getMinLevel();
+  const uint16_t max = led.getMaxLevel();
+  duty = led._mapToAnalog(_mapToLevel(phase + shift, min, max));
+
+  uint16_t ticks = 1;
+  while(ticks < ESPLED_PULSE_LOOKAHEAD && led._mapToAnalog(_mapToLevel(_offset + shift + ticks * _step, min, max)) == duty) {
+    ticks++;
+  }
+  return _timeTo(uint64_t(ticks) * _step, now_us);
+}
+
+uint16_t Pulse::_mapToLevel(uint32_t phase, uint16_t min, uint16_t max){
+
+  // Map sine from [-1,1] onto [min,max] brightness using Q16 math
+  const uint32_t span = (max > min) ? max - min : 0;
+  const uint32_t wave = int32_t(_mapToSine(phase)) + 32768;
+  return min + ((span * wave + 0x8000) >> 16);
+}
+
+
+
+/*
+  Functions for the pulse time base
+  The epoch only ever moves by whole refreshes, so the phase stays an exact
+  function of time no matter how late or irregular the ticks are
+  @params
+    Time in us from LedClock, truncated to 32 bits
+  @returns
+    _phaseAt() -> phase at that time
+    _timeTo() -> us from now until the phase reaches target
+*/
+uint32_t Pulse::_phaseAt(unsigned long now_us){
+  const uint32_t elapsed = now_us - _epoch_us;
+  const uint32_t ticks = elapsed / _tick_us;
+  _epoch_us += ticks * _tick_us;
+  _offset += ticks * _step;
+  return _offset + uint64_t(elapsed - ticks * _tick_us) * _step / _tick_us;
+}
+
+uint32_t Pulse::_timeTo(uint64_t target, unsigned long now_us){
+  // Waits are capped so the 32 bit time cannot wrap past the epoch while asleep
+  const uint32_t elapsed = now_us - _epoch_us;
+  const uint64_t at = _step ? (target * _tick_us + _step - 1) / _step : 0;
+  if(_step == 0 || at - elapsed > 0x7FFFFFFF) return 0x7FFFFFFF;
+  return (at > elapsed) ? at - elapsed : 0;
+}
+
+void Pulse::_sync(unsigned long now_us){
+
+  // Carry on from the current phase unless theta was moved by hand
+  if(_synced) {
+    const uint32_t phase = _phaseAt(now_us);
+    _offset = (_led->getPhase() != _published) ? _led->getPhase() : phase;
+  }
+  else {
+    _offset = _led->getPhase();
+  }
+  _epoch_us = now_us;
+  _published = _offset;
+
+  const unsigned long tick_us = hzToUs(_led->getRefreshRate());
+  _tick_us = tick_us ? tick_us : 1;
+  _step = _led->getPhaseStep();
+
+  _revision = _led->_revision;
+  _synced = true;
+  _updateFrames();
+}
+
+
+
+/*
+  Looks up or renders the cached waveform for the Led's current settings
+  Pulses with more than ESPLED_PULSE_RUNS changes per period, or that
+  find the pool full, are computed on every tick instead
+  @params
+    void
+  @returns
+    void
+*/
+void Pulse::_updateFrames(){
+
+  // Frames per period rounded to the nearest whole refresh
+  const uint64_t count = _step ? ((uint64_t(1) << 32) + _step / 2) / _step : 0;
+
+  PulseFramesKey key;
+  key.count = (count > 0xFFFF) ? 0 : count;
+  key.min = _led->getMinLevel();
+  key.max = _led->getMaxLevel();
+  key.style = _led->getStyle();
+  key.lut = _led->_lut;
+
+  if(_frames == nullptr || !(_frames->getKey() == key)) {
+    PulseFrames::release(_frames);
+    _frames = nullptr;
+
+    if(key.count > 0) {
+      _frames = PulseFrames::find(key);
+      if(_frames == nullptr && (_frames = PulseFrames::allocate(key)) != nullptr) {
+        _renderFrames();
+      }
+    }
+  }
+
+  _run = 0;
+  _runStart = 0;
+}
+
+void Pulse::_renderFrames(){
+  const PulseFramesKey &key = _frames->getKey();
+
+  for(uint16_t i = 0; i < key.count; i++) {
+    const uint32_t phase = (uint64_t(i) << 32) / key.count;
+    if(!_frames->append( _led->_mapToAnalog(_mapToLevel(phase, key.min, key.max)) )) {
+      // Too many changes to cache, compute on every tick instead
+      PulseFrames::release(_frames);
+      _frames = nullptr;
+      return;
+    }
+  }
+}
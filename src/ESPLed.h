@@ -12,18 +12,41 @@
 #define ESPLED_H
 
 #include <Arduino.h>
+#include <new>
 
 /*
-  Ticking handled using RTOS tasks for ESP32
+  Ticking for all Leds is handled by one shared scheduler
+  RTOS task for ESP32, Ticker for ESP8266
 */
-#ifndef ESP32
-#include <Ticker.h>
-#endif
+#include "LedScheduler.h"
+#include "LedBackend.h"
+#include "LedcAllocator.h"
+#include "LedOutput.h"
+#include "PulseFrames.h"
+#include "LedGroup.h"
+#include "BrightnessLut.h"
+#include "Keyframes.h"
+#include "Sequence.h"
+#include "SampleStream.h"
+#include "LedStats.h"
 
 #ifndef PWMRANGE
 #define PWMRANGE  1023
 #endif
 
+// Bytes reserved in each Led for its pulse / blink strategy
+// Strategies are constructed in place so switching modes never allocates
+#ifndef ESPLED_STRATEGY_SIZE
+#define ESPLED_STRATEGY_SIZE (16 * sizeof(void*))
+#endif
+
+// Bytes reserved in each Led for its fade, constructed on first use
+#ifndef ESPLED_FADE_SIZE
+#define ESPLED_FADE_SIZE (8 * sizeof(void*) + 32)
+#endif
+
+#define ESPLED_NO_PIN   0xFF
+
 #define NODEMCU_BUILTIN D0  // NodeMCU led
 #define ESP_BUILTIN     2   // The led on ESP12
 
@@ -31,33 +54,80 @@
 #define hzToMs(hz) (1000/hz)
 #define msToHz(ms) (1000/ms)
 
+// Pulse phase is a wrapping 32 bit accumulator, one full turn = 2^32
+#define PHASE_FULL_TURN   4294967296.0
+#define radsToPhase(rads) (uint32_t)((rads) / TWO_PI * PHASE_FULL_TURN)
+#define phaseToRads(phase) ((phase) * (TWO_PI / PHASE_FULL_TURN))
+
+// Most refreshes an uncached Pulse looks ahead for its next change
+#ifndef ESPLED_PULSE_LOOKAHEAD
+#define ESPLED_PULSE_LOOKAHEAD 64
+#endif
+
 
 
 /*
   IDEAS
   Finish adding RGB led functionality
-  Allow sync of Leds with a phase shift (ie destructively interfering waves)
 */
 
 typedef enum LED_STYLES { REG, INVERTED, RGB } led_style_t;
 typedef enum LED_COLORS {RED, ORANGE, YELLOW, GREEN, BLUE, WHITE} led_colors_t;
 
+// Setter calls queued for the scheduler task, see Led::_post()
+typedef enum LED_COMMANDS {
+  LED_CMD_MAX_LEVEL,
+  LED_CMD_MIN_LEVEL,
+  LED_CMD_PERIOD,
+  LED_CMD_PHASE,
+  LED_CMD_PHASE_STEP,
+  LED_CMD_REFRESH_RATE,
+  LED_CMD_INTERVAL,
+  LED_CMD_DURATION,
+  LED_CMD_ON_LEVEL,
+  LED_CMD_OFF,
+  LED_CMD_FADE_ON,        // Level, fade time in arg
+  LED_CMD_FADE_OFF,
+  LED_CMD_STYLE,
+  LED_CMD_LUT,            // Table address
+  LED_CMD_TRANSITION
+} led_command_t;
+
 class Led;
 class LedInterface;
 class Pulse;
+class HardwarePulse;
 class Blink;
+class Keyframes;
+class Sequence;
+class SampleStream;
+class Fade;
 // class ColorLed;
 
 class Led {
+  friend class Pulse;
+  friend class HardwarePulse;
+  friend class Blink;
+  friend class Keyframes;
+  friend class Fade;
+  friend class SampleStream;
+  friend class LedGroup;
+  friend class LedScheduler;
+  template<uint16_t> friend class PulseBank;
+#ifdef ESPLED_HOST
+  friend class LedBenchmark;
+#endif
 public:
 
   // Constructors
   Led();
 #ifdef ESP32
+  // Uses a particular LEDC channel rather than one picked automatically
   Led(uint8_t pin, uint8_t channel, led_style_t style = REG);
-#else
-  Led(uint8_t pin, led_style_t style = REG);
 #endif
+  Led(uint8_t pin, led_style_t style = REG);
+  // Drives a channel of an output such as a Pca9685 rather than a pin
+  Led(LedOutput &output, uint8_t channel, led_style_t style = REG);
   ~Led();
 
   
@@ -66,9 +136,13 @@ public:
     Setters General
   */
 
-  // Sets the LED pin
+  // Sets the LED pin, detaching it from any output
   Led &setPin(uint8_t pin);
 
+  // Writes PWM values to a channel of an output rather than a pin
+  // The output must outlive the Led, hardware fades and blinks are done in software
+  Led &setOutput(LedOutput &output, uint8_t channel);
+
   // LED_REG -> HIGH = on
   // LED_INVERTED -> LOW = off
   Led &setStyle(led_style_t style);
@@ -79,14 +153,26 @@ public:
   // Sets mainimum brightness as a percent [0,100]
   Led &setMinBrightness(uint8_t percent);
 
+  // Sets maximum brightness as a level [0,LED_LEVEL_MAX]
+  Led &setMaxLevel(uint16_t level);
+
+  // Sets minimum brightness as a level [0,LED_LEVEL_MAX]
+  Led &setMinLevel(uint16_t level);
+
   // Returns the LED to manual control
   Led &manual();
 
+  // Sets the table used to map percent brightness onto PWM values
+  // The PWM resolution follows the table, on ESP8266 this is global
+  Led &setBrightnessLut(const BrightnessLut &lut);
+
 #ifdef ESP32
   // Set which of the 16 PWM channels to use
+  // Channels are otherwise assigned automatically by LedcAllocator
   Led &setChannel(uint8_t channel);
 
   // Set the frequency of the PWM signal in Hz
+  // Leds with the same frequency and resolution share a timer
   Led &setFrequency(unsigned long hz);
 #endif
 
@@ -104,12 +190,28 @@ public:
   // Sets the increment in theta, how fast pulsing happens
   Led &setDeltaTheta(float radians);
 
+  // Sets theta as a fixed point phase, one full turn = 2^32
+  Led &setPhase(uint32_t phase);
+
+  // Sets the fixed point increment in phase per refresh
+  Led &setPhaseStep(uint32_t step);
+
   // Sets how many steps theta will take per second
+  // The pulse period is preserved, fades refresh at the same rate
   Led &setRefreshRate(unsigned int hz);
 
+  // Sets how long start() crossfades from the current output into a new mode
+  // 0, the default, switches instantly from off
+  Led &setTransition(unsigned long ms);
+
   // Puts the Led in pulse mode using LedInterface
   Led &pulse();
 
+  // Puts the Led in pulse mode using the PWM unit's hardware fades
+  // The CPU only wakes twice per period, brightness ramps linearly in duty
+  // Falls back to pulse() where no fade unit is available
+  Led &hardwarePulse();
+
 
 
 
@@ -124,7 +226,40 @@ public:
   Led &setDuration(unsigned long ms);
   
   // Puts the Led in blink mode using LedInterface
+  // Where the PWM unit can blink on its own it does, with no interrupts
   Led &blink();
+
+
+
+  /*
+    Setters Keyframes
+  */
+
+  // Plays a compiled keyframe animation using LedInterface
+  // The table is not copied and must outlive the animation
+  Led &keyframes(const KeyframeTable &table);
+
+
+
+
+  /*
+    Setters Sequence
+  */
+
+  // Plays a blink pattern byte code from PROGMEM using LedInterface
+  // See Sequence.h for the instruction set
+  Led &sequence(const uint8_t *pattern);
+
+
+
+  /*
+    Setters Stream
+  */
+
+  // Follows samples pushed into a ring using LedInterface
+  // smoothing [0,255] is how much of the previous level each refresh keeps
+  // The ring is not copied and must outlive the stream, see SampleStream.h
+  Led &stream(LedSamples &samples, stream_mode_t mode = STREAM_LATEST, uint8_t smoothing = 0);
   
   
 
@@ -136,6 +271,9 @@ public:
   // Returns the pin in use
   const uint8_t getPin() { return _gpio.pin; }
 
+  // Returns the output written to, nullptr when driving a pin
+  LedOutput *getOutput() { return _output; }
+
   // Returns the LED style (LED_INVERTED / LED_REG)
   led_style_t getStyle(){ return _gpio.style; }
 
@@ -143,13 +281,23 @@ public:
   const bool isOn() { return _isOn; }
 
   // Returns the maximum brightness as a percent [0,100]
-  uint8_t getMaxBrightness() { return _brightness.max; }
+  uint8_t getMaxBrightness() { return levelToPercent(_brightness.max); }
 
   // Returns the brightness corresponding to the off state as a percent [0,100]
-  uint8_t getMinBrightness() { return _brightness.min; }
+  uint8_t getMinBrightness() { return levelToPercent(_brightness.min); }
+
+  // Returns the maximum brightness as a level [0,LED_LEVEL_MAX]
+  uint16_t getMaxLevel() { return _brightness.max; }
+
+  // Returns the off state brightness as a level [0,LED_LEVEL_MAX]
+  uint16_t getMinLevel() { return _brightness.min; }
+
+  // Returns the PWM resolution in bits
+  uint8_t getResolution() { return _resolution; }
 
 #ifdef ESP32
   // Returns the PWM channel for this Led
+  // ESPLED_NO_CHANNEL if channels or timers ran out
   uint8_t getChannel() { return _gpio.ledChannel; }
 
   // Gets the PWM frequency in Hz
@@ -166,14 +314,23 @@ public:
   unsigned long getPeriod();
   
   // Gets the theta value in radians used to calculate brightness
-  float getTheta() { return _theta_rads; }
+  float getTheta() { return phaseToRads(_phase); }
 
   // Gets the incremental change in theta in radians
-  float getDeltaTheta(){ return _step_rads; };
+  float getDeltaTheta(){ return phaseToRads(_phaseStep); };
+
+  // Gets theta as a fixed point phase, one full turn = 2^32
+  uint32_t getPhase() { return _phase; }
+
+  // Gets the fixed point increment in phase per refresh
+  uint32_t getPhaseStep() { return _phaseStep; }
 
   // Gets the rate in Hz at which theta is incremented
   unsigned int getRefreshRate() { return _refreshRate_hz; }
 
+  // Gets the crossfade time into a new mode in ms
+  unsigned long getTransition() { return _transition_ms; }
+
 
 
   /*
@@ -196,20 +353,50 @@ public:
   // Turns the LED on to a given brightness
   Led &on(uint8_t percent);
 
+  // Turns the LED on to a given brightness level [0,LED_LEVEL_MAX]
+  Led &onLevel(uint16_t level);
+
   // Turns the LED on to max brightness
   Led &on();
 
   // Turns the LED off
   Led &off();
 
+  // Fades to a brightness as a percent [0,100] over fade_ms
+  // The fade runs from the scheduler, the Led is put in manual mode
+  Led &on(uint8_t percent, unsigned long fade_ms);
+
+  // Fades to a brightness level [0,LED_LEVEL_MAX] over fade_ms
+  Led &onLevel(uint16_t level, unsigned long fade_ms);
+
+  // Fades to min brightness over fade_ms and turns the LED off
+  Led &off(unsigned long fade_ms);
+
+  // Returns true while a fade or crossfade is running
+  bool isFading();
+
   // Toggles the LED to the specified power level as a percent [0,100]
   Led &toggle(uint8_t percent);
 
   // Toggles the LED using max/min brightness
   Led &toggle();
 
-  // NOT YET IMPLEMENTED
-  // void sync(Led &master);
+  // Locks this Led to the time base of a pulsing master
+  // phaseOffset is added to the master's phase, ie 0x80000000 pulses in counter phase
+  // The master's period and refresh rate apply, brightness settings stay per Led
+  Led &sync(Led &master, uint32_t phaseOffset = 0);
+
+  // Returns true if the Led follows a master
+  bool isSynced() { return _master != nullptr; }
+
+#ifdef ESPLED_INSTRUMENT
+  // Also records the timing of this Led's ticks into stats, nullptr to stop
+  // Stats of a synced Led are recorded by its master
+  Led &setStats(LedStats *stats) { _stats = stats; return *this; }
+
+  // Returns the stats set with setStats()
+  LedStats *getStats() { return _stats; }
+#endif
 
 
   // Action wrappers
@@ -219,44 +406,94 @@ public:
   // Start or stop the interface
   virtual Led &start();
   virtual Led &stop();
+
+  // Returns true if the mode is running or being crossfaded into
+  // False after start() means the scheduler had no memory left for it
+  bool isStarted();
  
 
 protected:
 
   struct {
-    uint8_t pin;
+    uint8_t pin = ESPLED_NO_PIN;
     led_style_t style = INVERTED;
 
 #ifdef ESP32
     unsigned int freq = 5000;
-    uint8_t ledChannel = 0;
-    const uint8_t resolution = 10;  // Use 10 bit resolution to match default for ESP8266
+    uint8_t ledChannel = ESPLED_NO_CHANNEL;
  #endif
   } _gpio;
 
+  // Output written to instead of the pin, nullptr for native PWM
+  LedOutput *_output = nullptr;
+  uint8_t _outputChannel = 0;
+
+  // Brightness table in flash and the PWM range it was made for
+  // Use 10 bit resolution to match default for ESP8266
+  const BrightnessLut *_lut = &_brightnessLut;
+  uint8_t _resolution = 10;
+  uint16_t _range = 1023;
+
 
   struct {
-    uint8_t max = 100; // The analogWrite() maximum
-    uint8_t min = 0;
+    uint16_t max = LED_LEVEL_MAX; // The analogWrite() maximum
+    uint16_t min = 0;
   } _brightness;
 
-  LedInterface *_strategy;
-  bool _isOn;
+  // Active strategy, always points into _storage or is nullptr
+  LedInterface *_strategy = nullptr;
+  alignas(8) uint8_t _storage[ESPLED_STRATEGY_SIZE];
+
+  // Fade used by transitions, nullptr until the first one
+  Fade *_fade = nullptr;
+  alignas(8) uint8_t _fadeStorage[ESPLED_FADE_SIZE];
+  unsigned long _transition_ms = 0;
+
+  // Fades from the current output to a level, then starts next if given
+  void _fadeTo(uint16_t level, unsigned long fade_ms, bool on, LedInterface *next);
+
+  // Stops a running fade, the output holds where it is
+  void _stopFade();
+
+  // Returns the brightness level the output is currently at
+  uint16_t _currentLevel();
+  bool _isOn = false;
 
   /*
-    Maps a power level in percent to an 10 bit analogWrite value
+    Maps a brightness level to a PWM value using the brightness table
     Compensation for the antilog nature of brightness perception is included
+    Levels between table entries are interpolated to the full resolution
     Returned value will be adjusted for led_style_t
   */
-  uint16_t _mapToAnalog(uint8_t percent);
+  uint16_t _mapToAnalog(uint16_t level);
+
+  // Writes a raw PWM value to the pin or output, skipped if it is already written
+  void _write(uint16_t duty);
+
+  // Returns the PWM channel on ESP32, the pin elsewhere
+  uint8_t _channel();
+
+#ifdef ESP32
+  // Moves the channel onto a timer matching the frequency and resolution
+  void _retime();
+#endif
+
+  // Last PWM value written, _DUTY_UNKNOWN forces the next write
+  static const uint32_t _DUTY_UNKNOWN = 0xFFFFFFFF;
+  uint32_t _duty = _DUTY_UNKNOWN;
+
+  // Incremented whenever a setting that shapes the pulse changes
+  uint8_t _revision = 0;
+
+  // Bumps the revision and lets the active interface react
+  void _reshape();
 
-  
   /*
     Pulse variables
   */
-  unsigned int _refreshRate_hz = 60;   // Refresh rate for pulse mode
-  float _theta_rads = PI;              // Current value of theta
-  float _step_rads = PI;               // Incremental change of theta
+  unsigned int _refreshRate_hz = 60;     // Refresh rate for pulse mode
+  uint32_t _phase = 0x80000000;          // Current value of theta, starts at pi
+  uint32_t _phaseStep = 0x80000000;      // Incremental change of theta
 
   /*
     Blink variables
@@ -264,6 +501,33 @@ protected:
   unsigned long _interval_ms = 3000;     // Interval on which to Pulse/blink
   unsigned long _duration_ms = 300;      // How long the led stays lit during a blink
 
+  /*
+    Sync variables
+    Followers form a linked list off their master, which drives them all
+    from its own Pulse tick
+  */
+  Led *_master = nullptr;                // Led this one is synced to
+  Led *_nextFollower = nullptr;          // Next Led synced to the same master
+  Led *_followers = nullptr;             // First Led synced to this one
+  uint32_t _syncOffset = 0;              // Phase offset from the master
+
+#ifdef ESPLED_INSTRUMENT
+  LedStats *_stats = nullptr;
+#endif
+
+  // Queues a setter call if the scheduler task owns this Led
+  // Returns false if the caller should apply it now
+  bool _post(uint8_t op, uintptr_t value, uint32_t arg = 0);
+
+  // Applies a queued setter call
+  void _apply(uint8_t op, uintptr_t value, uint32_t arg);
+
+  // Detaches this Led from its master
+  void _unsync();
+
+  // Detaches every Led synced to this one
+  void _releaseFollowers();
+
   //virtual void _handle() { }
   
 
@@ -274,13 +538,20 @@ private:
 
 /*
   Interface to handle scheduled things like pulsing / blinking
+  Timing is provided by the shared LedScheduler
 */
 class LedInterface {
+  friend class LedScheduler;
+  friend class Led;
+#ifdef ESPLED_HOST
+  friend class LedBenchmark;
+#endif
 public:
   LedInterface(){}
+  virtual ~LedInterface() { stop(); }
 
   // Start actting
-  virtual void start() { if(!isStarted()) this->_setupTimer(); }
+  virtual void start();
 
   // Stop acting
   virtual void stop();
@@ -294,18 +565,26 @@ protected:
   Led *_led = nullptr;
   bool _started = false;
 
-  virtual unsigned long _handle() = 0;
+  // Handle an action, returns the time in us until the next action
+  virtual uint64_t _handle() = 0;
 
-#ifdef ESP32
-  TaskHandle_t _taskHandle = NULL;
-#else
-  Ticker _tick;
+  // Called when Led settings that shape the output change
+  virtual void _reshape() { }
+
+  // Returns the level of the first frame, crossfades end there
+  virtual uint16_t _firstLevel() { return _led->getMinLevel(); }
+
+#ifdef ESPLED_INSTRUMENT
+  // Which LedStats ticks are recorded into
+  virtual uint8_t _statsKind() { return LED_STATS_OTHER; }
 #endif
 
-  virtual void _setupTimer() = 0;
-  //static void _tickerWrap(void*) {}
-  
+  // Converts a wait measured from now into one measured from _deadline_us
+  uint64_t _fromNow(uint64_t wait_us) { return LedClock::now() - _deadline_us + wait_us; }
 
+  // Scheduler bookkeeping
+  uint64_t _deadline_us = 0;
+  int16_t _heapIndex = -1;
 
 };
 
@@ -318,50 +597,285 @@ public:
 
   unsigned long getPeriod() { return _led->getPeriod(); }
 
+  // Start blinking, in hardware if possible
+  void start();
+
+  // Stop blinking, a hardware blink leaves the Led off
+  void stop();
+
+  // Returns true if the PWM unit is doing the blinking
+  bool isHardware() { return _hardware; }
+
 protected:
+
+  ESPLED_STATS_KIND(LED_STATS_BLINK)
   
   // Handle blinking, returns the time until the next action
-  unsigned long _handle();
+  uint64_t _handle();
+
+  // Restarts blinking so new settings apply
+  void _reshape();
+
+  // Blinks start with the Led on
+  uint16_t _firstLevel() { return _led->getMaxLevel(); }
 
-  // Static ISR wrapper, pass (void*)this and cast back to interface subclass
-  static void _tickerWrap(void*); 
+  // Hands the blink to the PWM unit, returns false if it cannot do it
+  bool _startHardware();
 
-  // Start ticking
-  void _setupTimer();
+  bool _hardware = false;
 
 
 };
 
+static_assert(sizeof(Blink) <= ESPLED_STRATEGY_SIZE, "Blink does not fit in ESPLED_STRATEGY_SIZE");
+
+
 class Pulse : public LedInterface {
+#ifdef ESPLED_HOST
+  friend class LedBenchmark;
+#endif
 public:
 
   Pulse(Led &led) { _led = &led; }
+  ~Pulse() { PulseFrames::release(_frames); }
 
   unsigned long getDuration() { return _led->getDuration(); }
   unsigned long getInterval() { return _led->getInterval(); }
 
-  
+  // Start pulsing from the Led's current theta
+  void start();
 
 protected:
 
-  // Handle blinking, returns the time until the next action
-  unsigned long _handle();
+  ESPLED_STATS_KIND(LED_STATS_PULSE)
+
+  // Handle pulsing, returns the time until the output next changes
+  uint64_t _handle();
+
+  // Wakes the pulse early so new settings apply immediately
+  void _reshape();
+
+  // Pulses carry on from the Led's current theta
+  uint16_t _firstLevel() { return _mapToLevel(_led->getPhase(), _led->getMinLevel(), _led->getMaxLevel()); }
+
+  /*
+    Time base
+    Phase is a pure function of LedClock, it equals _offset at _epoch_us
+    and advances _step every _tick_us. Late ticks skip frames rather than
+    slowing the pulse down.
+  */
+  unsigned long _epoch_us = 0;
+  uint32_t _offset = 0;
+  uint32_t _step = 0;
+  uint32_t _tick_us = 1000;
+  uint32_t _published = 0;    // Last phase written back to the Led
+
+  // Cached waveform and position within it, nullptr if computed live
+  PulseFrames *_frames = nullptr;
+  uint16_t _run = 0;
+  uint16_t _runStart = 0;     // First frame of the current run
+
+  // Led revision the time base and cache were built for
+  uint8_t _revision;
+  bool _synced = false;
+
+  // Returns the phase at a point in time, moving the epoch up to it
+  uint32_t _phaseAt(unsigned long now_us);
 
-  // Static ISR wrapper, pass (void*)this and cast back to interface subclass
-  static void _tickerWrap(void*);
+  // Returns the time in us from now until the phase reaches target
+  // target is relative to _offset and may exceed one turn
+  uint32_t _timeTo(uint64_t target, unsigned long now_us);
 
-  // Start ticking
-  void _setupTimer();
+  // Restarts the time base from now using the Led's current settings
+  void _sync(unsigned long now_us);
 
+  // Swaps in a cached waveform matching the Led's current settings
+  void _updateFrames();
+
+  // Renders one period into the newly allocated _frames
+  void _renderFrames();
+
+  // Returns the brightness level at a fixed point phase
+  static uint16_t _mapToLevel(uint32_t phase, uint16_t min, uint16_t max);
+
+  // Computes the duty of a Led at phase + shift without using the cache
+  // Returns the time in us until that duty next changes
+  uint32_t _renderLive(Led &led, uint32_t shift, uint32_t phase, unsigned long now_us, uint16_t &duty);
 
 private:
 
-  // Returns the approximate sine of an angle in radians
-  // Done using a [0,pi/2] lookup table
-  float _mapToSine(float theta);
+  // Returns the sine of a fixed point phase in Q15, [-32767, 32767]
+  // Done using a [0,pi/2] lookup table with linear interpolation
+  static int16_t _mapToSine(uint32_t phase);
+
+};
+
+static_assert(sizeof(Pulse) <= ESPLED_STRATEGY_SIZE, "Pulse does not fit in ESPLED_STRATEGY_SIZE");
+
+
+class HardwarePulse : public Pulse {
+public:
+
+  HardwarePulse(Led &led) : Pulse(led) { }
+
+  // Start fading up from min brightness
+  void start();
+
+  // Stop acting, any running fade is halted
+  void stop();
+
+protected:
+
+  ESPLED_STATS_KIND(LED_STATS_HARDWARE_PULSE)
+
+  // Programs the next fade, returns the time until it completes
+  uint64_t _handle();
+
+  // Restarts the fade cycle so new settings apply immediately
+  void _reshape();
+
+  // Hardware fades start up from min brightness
+  uint16_t _firstLevel() { return _led->getMinLevel(); }
+
+  bool _rising = true;      // Direction of the next fade
+  bool _software = false;   // Fell back to the software pulse
+
+};
+
+static_assert(sizeof(HardwarePulse) <= ESPLED_STRATEGY_SIZE, "HardwarePulse does not fit in ESPLED_STRATEGY_SIZE");
+
+
+class Keyframes : public LedInterface {
+public:
+
+  Keyframes(Led &led, const KeyframeTable &table) : _table(&table) { _led = &led; }
+
+  // Restarts the animation from its first keyframe
+  void start();
+
+protected:
+
+  ESPLED_STATS_KIND(LED_STATS_KEYFRAMES)
+
+  // Handle one frame, returns the time until the output next changes
+  uint64_t _handle();
+
+  // Wakes up early so brightness changes apply immediately
+  void _reshape();
+
+  // Level of the first keyframe
+  uint16_t _firstLevel();
+
+  // Scales a keyframe level into the Led's brightness range
+  uint16_t _toLevel(uint16_t rel);
+
+  const KeyframeTable *_table;
+  unsigned long _epoch_ms = 0;    // Time in ms at the start of the current loop
+  uint8_t _segment = 0;           // Segment played last, where the search resumes
+  bool _synced = false;
 
 };
 
+static_assert(sizeof(Keyframes) <= ESPLED_STRATEGY_SIZE, "Keyframes does not fit in ESPLED_STRATEGY_SIZE");
+
+
+class Sequence : public LedInterface {
+public:
+
+  Sequence(Led &led, const uint8_t *pattern) : _pattern(pattern) { _led = &led; }
+
+  // Restarts the pattern from its first instruction
+  void start();
+
+protected:
+
+  ESPLED_STATS_KIND(LED_STATS_SEQUENCE)
+
+  // Runs instructions up to the next wait, returns the wait time
+  uint64_t _handle();
+
+  const uint8_t *_pattern;        // Byte code in PROGMEM
+  uint16_t _pc = 0;               // Offset of the next instruction
+
+  // Open SEQ_REPEAT blocks, deeper blocks than this play once
+  struct {
+    uint16_t start;               // Offset of the first instruction in the block
+    uint8_t remaining;            // Repeats left after the current pass
+  } _loops[ESPLED_SEQUENCE_DEPTH];
+  uint8_t _depth = 0;
+
+};
+
+static_assert(sizeof(Sequence) <= ESPLED_STRATEGY_SIZE, "Sequence does not fit in ESPLED_STRATEGY_SIZE");
+
+
+class SampleStream : public LedInterface {
+public:
+
+  SampleStream(Led &led, LedSamples &samples, stream_mode_t mode, uint8_t smoothing)
+    : _samples(&samples), _mode(mode), _smoothing(smoothing) { _led = &led; }
+
+  // Starts following from the current output
+  void start();
+
+  // Returns the number of samples read / refreshes that found no new sample
+  uint32_t getSamples() { return _read; }
+  uint32_t getStarved() { return _starved; }
+
+protected:
+
+  ESPLED_STATS_KIND(LED_STATS_STREAM)
+
+  // Reads every waiting sample, returns the time until the next refresh
+  uint64_t _handle();
+
+  LedSamples *_samples;
+  stream_mode_t _mode;
+  uint8_t _smoothing;
+  uint32_t _level = 0;      // Output in Q8 levels relative to the range
+  uint32_t _read = 0;
+  uint32_t _starved = 0;
+
+};
+
+static_assert(sizeof(SampleStream) <= ESPLED_STRATEGY_SIZE, "SampleStream does not fit in ESPLED_STRATEGY_SIZE");
+
+
+/*
+  Linear fade in brightness level from wherever the output is, computed a
+  refresh at a time by the scheduler. Each Led has its own so a fade can
+  lead into a strategy without taking its place.
+*/
+class Fade : public LedInterface {
+public:
+
+  Fade(Led &led) { _led = &led; }
+
+  // Fades to level over fade_ms, then holds it on / off or starts next
+  void begin(uint16_t level, unsigned long fade_ms, bool on, LedInterface *next);
+
+protected:
+
+  ESPLED_STATS_KIND(LED_STATS_FADE)
+
+  // Writes the level for now, returns the time until the next refresh
+  uint64_t _handle();
+
+  // Writes the final level and hands over to the next strategy
+  void _finish();
+
+  uint64_t _start_us = 0;
+  uint32_t _duration_us = 0;
+  uint16_t _from = 0;
+  uint16_t _to = 0;
+  LedInterface *_next = nullptr;  // Strategy started once the fade ends
+  bool _on = true;                // State the Led is left in
+
+};
+
+static_assert(sizeof(Fade) <= ESPLED_FADE_SIZE, "Fade does not fit in ESPLED_FADE_SIZE");
+
+
 
 // NYI
 // class ColorLed : public Led {
@@ -0,0 +1,105 @@
+#include "Keyframes.h"
+#include "BrightnessLut.h"
+
+
+KeyframeTable::KeyframeTable(const Keyframe *frames, uint8_t count, bool loop) {
+  compile(frames, count, loop);
+}
+
+
+
+/*
+  Compiles keyframes into integer segments
+  Times must be strictly increasing and start at 0
+  @params
+    Array of keyframes, number of keyframes, true to repeat the animation
+  @returns
+    false if there are fewer than 2 / more than ESPLED_KEYFRAMES keyframes
+    or the times are out of order
+*/
+bool KeyframeTable::compile(const Keyframe *frames, uint8_t count, bool loop) {
+  _count = 0;
+  _loop = loop;
+  if(frames == nullptr || count < 2 || count > ESPLED_KEYFRAMES) return false;
+  if(frames[0].time_ms != 0) return false;
+
+  for(uint8_t i = 0; i < count; i++) {
+    KeyframeSegment &seg = _segment[i];
+    seg.start_ms = frames[i].time_ms;
+    seg.from = percentToLevel(frames[i].percent > 100 ? 100 : frames[i].percent);
+    seg.easing = frames[i].easing;
+    seg.delta = 0;
+    seg.scale = 0;
+
+    if(i == 0) continue;
+
+    KeyframeSegment &prev = _segment[i - 1];
+    if(seg.start_ms <= prev.start_ms) return false;
+    prev.delta = int32_t(seg.from) - prev.from;
+    prev.scale = 0xFFFFFFFF / (seg.start_ms - prev.start_ms);
+  }
+
+  _count = count;
+  return true;
+}
+
+
+
+/*
+  Evaluates the animation at a point in time
+  @params
+    Time in ms [0,getPeriod()), segment to begin the search from
+  @returns
+    Relative level [0,LED_LEVEL_MAX]
+*/
+uint16_t KeyframeTable::levelAt(uint16_t t_ms, uint8_t &index) const {
+  if(!isValid()) return 0;
+  if(t_ms >= getPeriod()) {
+    index = _count - 2;
+    return _segment[_count - 1].from;
+  }
+
+  // Times only go backwards when the animation wraps
+  if(index > _count - 2 || t_ms < _segment[index].start_ms) index = 0;
+  while(t_ms >= _segment[index + 1].start_ms) index++;
+
+  const KeyframeSegment &seg = _segment[index];
+
+  // Elapsed time is always less than the duration, so this fits in 32 bits
+  const uint16_t frac = (uint32_t(t_ms - seg.start_ms) * seg.scale) >> 16;
+
+  // Halve the fraction so the product stays within an int32
+  const int32_t eased = _ease(frac, seg.easing) >> 1;
+  return seg.from + ((seg.delta * eased) >> 15);
+}
+
+
+
+/*
+  Easing curves on a Q16 fraction [0,65535]
+  Polynomials only, each costs at most two multiplies
+*/
+uint16_t KeyframeTable::_ease(uint16_t frac, uint8_t easing) {
+  const uint32_t f = frac;
+  switch(easing) {
+    case EASE_IN:
+      return (f * f) >> 16;
+
+    case EASE_OUT: {
+      const uint32_t inv = 0xFFFF - f;
+      return 0xFFFF - ((inv * inv) >> 16);
+    }
+
+    case EASE_IN_OUT: {
+      // f^2 * (3 - 2f), scaled down by 4 to stay within 32 bits
+      const uint32_t f2 = (f * f) >> 16;
+      return (f2 * ((3 * 0x10000 - 2 * f) >> 2)) >> 14;
+    }
+
+    case EASE_STEP:
+      return 0;
+
+    default:
+      return frac;
+  }
+}
@@ -0,0 +1,109 @@
+/*
+  Keyframes.h
+
+  Brightness animations described by a list of time / brightness points.
+  Each keyframe starts a segment that runs to the next keyframe, shaped by
+  its easing curve. The list is compiled once into a table of integer
+  segments, so evaluating a frame is a short table walk and a few
+  multiplies with no floating point or trig.
+
+  A heartbeat that loops every 1.2s, ie
+
+    const Keyframe beat[] = {
+      {   0,   0, EASE_OUT },
+      { 120, 100, EASE_IN_OUT },
+      { 240,  20, EASE_OUT },
+      { 360,  80, EASE_IN },
+      { 600,   0, EASE_STEP },
+      {1200,   0, EASE_STEP }
+    };
+    KeyframeTable heartbeat(beat, 6);
+    led.keyframes(heartbeat).start();
+
+*/
+
+#ifndef ESPLED_KEYFRAMES_H
+#define ESPLED_KEYFRAMES_H
+
+#include <Arduino.h>
+
+// Most keyframes a table may hold, including the final one
+#ifndef ESPLED_KEYFRAMES
+#define ESPLED_KEYFRAMES 16
+#endif
+
+// Shape of the segment leading away from a keyframe
+typedef enum KEYFRAME_EASINGS {
+  EASE_LINEAR,      // Constant rate
+  EASE_IN,          // Quadratic, starts slow
+  EASE_OUT,         // Quadratic, ends slow
+  EASE_IN_OUT,      // Smoothstep, slow at both ends
+  EASE_STEP         // Holds brightness until the next keyframe
+} keyframe_easing_t;
+
+// One point of an animation
+struct Keyframe {
+  uint16_t time_ms;           // Time from the start of the animation
+  uint8_t percent;            // Brightness [0,100] between min and max brightness
+  keyframe_easing_t easing;   // Curve used to reach the next keyframe
+};
+
+// Compiled segment, values are levels [0,LED_LEVEL_MAX]
+struct KeyframeSegment {
+  uint16_t start_ms;
+  uint16_t from;
+  int32_t delta;              // Change in level over the segment
+  uint32_t scale;             // 2^32 / duration, maps time onto Q16
+  uint8_t easing;
+};
+
+class KeyframeTable {
+public:
+
+  // Compiles the keyframes, see compile()
+  KeyframeTable(const Keyframe *frames, uint8_t count, bool loop = true);
+
+  // Compiles keyframes into segments
+  // Returns false and leaves the table empty if the keyframes are invalid
+  bool compile(const Keyframe *frames, uint8_t count, bool loop = true);
+
+  // Returns true if the table holds an animation
+  bool isValid() const { return _count >= 2; }
+
+  // Returns true if the animation repeats
+  bool isLoop() const { return _loop; }
+
+  // Returns the time of the last keyframe in ms
+  uint16_t getPeriod() const { return _count ? _segment[_count - 1].start_ms : 0; }
+
+  // Returns the number of keyframes held
+  uint8_t size() const { return _count; }
+
+  // Returns the relative level [0,LED_LEVEL_MAX] at time t_ms
+  // index is the segment to start searching from and is advanced to the
+  // segment holding t_ms, so playing forward costs O(1) per frame
+  uint16_t levelAt(uint16_t t_ms, uint8_t &index) const;
+
+  // Returns the time in ms at which segment index ends
+  uint16_t endOf(uint8_t index) const { return _segment[index + 1].start_ms; }
+
+  // Returns true if the level does not change during segment index
+  bool isFlat(uint8_t index) const {
+    return _segment[index].delta == 0 || _segment[index].easing == EASE_STEP;
+  }
+
+protected:
+
+  // Segments in time order, the last entry marks the end of the animation
+  KeyframeSegment _segment[ESPLED_KEYFRAMES];
+  uint8_t _count = 0;
+  bool _loop = true;
+
+  // Applies an easing curve to a Q16 fraction of a segment
+  static uint16_t _ease(uint16_t frac, uint8_t easing);
+
+private:
+
+};
+
+#endif
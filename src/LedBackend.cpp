@@ -0,0 +1,167 @@
+#include "LedBackend.h"
+
+// Largest clock divider, 10 integer and 8 fractional bits
+#define BLINK_DIVIDER_MAX 0x3FFFF
+#define BLINK_DIVIDER_MIN 0x100
+
+
+
+/*
+  Works out timer settings for a hardware blink
+  frequency = clock / (divider * 2^bits) and duty = high / period
+  @params
+    Blink period and high time in ms, timer clock and widest resolution
+  @returns
+    false if the settings are out of range, out is left untouched
+*/
+bool LedBackend::blinkConfig(uint32_t period_ms, uint32_t high_ms, uint32_t clock_hz, uint8_t maxBits, PwmBlink &out) {
+  if(period_ms == 0 || high_ms == 0 || high_ms >= period_ms) return false;
+
+  // Divider in Q8 = clock * 256 * period / (1000 * 2^bits)
+  // Fewer bits only make the divider bigger, so take the first that fits
+  const uint64_t scaled = uint64_t(clock_hz) * 256 * period_ms;
+  for(uint8_t bits = maxBits; bits > 0; bits--) {
+    const uint64_t den = uint64_t(1000) << bits;
+    const uint64_t divider = (scaled + den / 2) / den;
+    if(divider < BLINK_DIVIDER_MIN) continue;
+    if(divider > BLINK_DIVIDER_MAX) return false;
+
+    const uint32_t duty = ((uint64_t(high_ms) << bits) + period_ms / 2) / period_ms;
+    if(duty == 0 || duty >= (uint32_t(1) << bits)) return false;
+
+    out.divider = divider;
+    out.bits = bits;
+    out.duty = duty;
+    return true;
+  }
+
+  // Period is too short to divide the clock down to
+  return false;
+}
+
+// The host build supplies its own backend in extras/host
+#ifndef ESPLED_HOST
+
+#ifdef ESP32
+
+#include "driver/ledc.h"
+#include "esp_idf_version.h"
+#include "soc/soc_caps.h"
+#include "LedcAllocator.h"
+
+/*
+  Arduino numbers LEDC channels 0-15, the first 8 in the high speed group
+  and the rest in the low speed group
+*/
+#define LEDC_MODE(channel)    ((ledc_mode_t)((channel) / 8))
+#define LEDC_CHANNEL(channel) ((ledc_channel_t)((channel) % 8))
+
+/*
+  Timers and channels are configured here rather than with ledcSetup(),
+  which ties each pair of channels to a fixed timer
+*/
+bool LedBackend::setupTimer(uint8_t channel, uint8_t timer, uint32_t hz, uint8_t bits) {
+  ledc_timer_config_t config = {};
+  config.speed_mode = LEDC_MODE(channel);
+  config.duty_resolution = (ledc_timer_bit_t)bits;
+  config.timer_num = (ledc_timer_t)timer;
+  config.freq_hz = hz;
+  config.clk_cfg = LEDC_AUTO_CLK;
+  return ledc_timer_config(&config) == ESP_OK;
+}
+
+bool LedBackend::bindTimer(uint8_t channel, uint8_t timer) {
+  return ledc_bind_channel_timer(LEDC_MODE(channel), LEDC_CHANNEL(channel), (ledc_timer_t)timer) == ESP_OK;
+}
+
+bool LedBackend::attach(uint8_t channel, uint8_t pin) {
+  const int8_t timer = LedcAllocator::getTimer(channel);
+  if(timer == ESPLED_NO_TIMER) return false;
+
+  ledc_channel_config_t config = {};
+  config.gpio_num = pin;
+  config.speed_mode = LEDC_MODE(channel);
+  config.channel = LEDC_CHANNEL(channel);
+  config.intr_type = LEDC_INTR_DISABLE;
+  config.timer_sel = (ledc_timer_t)timer;
+  config.duty = 0;
+  config.hpoint = 0;
+  return ledc_channel_config(&config) == ESP_OK;
+}
+
+void LedBackend::write(uint8_t channel, uint32_t duty, uint8_t bits) {
+  // LEDC needs one past the maximum to stay high for the whole cycle
+  if(bits > 1 && duty == (uint32_t(1) << bits) - 1) duty++;
+  ledc_set_duty(LEDC_MODE(channel), LEDC_CHANNEL(channel), duty);
+  ledc_update_duty(LEDC_MODE(channel), LEDC_CHANNEL(channel));
+}
+
+bool LedBackend::hasFade() {
+  static bool installed = false;
+  if(!installed) {
+    const esp_err_t err = ledc_fade_func_install(0);
+    installed = (err == ESP_OK || err == ESP_ERR_INVALID_STATE);
+  }
+  return installed;
+}
+
+bool LedBackend::fade(uint8_t channel, uint32_t target, uint32_t time_ms) {
+  if(!hasFade()) return false;
+  if(ledc_set_fade_with_time(LEDC_MODE(channel), LEDC_CHANNEL(channel), target, time_ms) != ESP_OK) return false;
+  return ledc_fade_start(LEDC_MODE(channel), LEDC_CHANNEL(channel), LEDC_FADE_NO_WAIT) == ESP_OK;
+}
+
+void LedBackend::stopFade(uint8_t channel) {
+  if(!hasFade()) return;
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+  ledc_fade_stop(LEDC_MODE(channel), LEDC_CHANNEL(channel));
+#else
+  // Older IDF has no way to cancel, replace the fade with one that holds
+  const uint32_t duty = ledc_get_duty(LEDC_MODE(channel), LEDC_CHANNEL(channel));
+  ledc_set_fade_with_time(LEDC_MODE(channel), LEDC_CHANNEL(channel), duty, 0);
+  ledc_fade_start(LEDC_MODE(channel), LEDC_CHANNEL(channel), LEDC_FADE_NO_WAIT);
+#endif
+}
+
+bool LedBackend::blinkLimits(uint32_t &clock_hz, uint8_t &maxBits) {
+#if SOC_LEDC_SUPPORT_REF_TICK
+  // 1MHz REF_TICK reaches periods of minutes at full resolution
+  clock_hz = 1000000;
+  maxBits = SOC_LEDC_TIMER_BIT_WIDE_NUM;
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool LedBackend::blink(uint8_t channel, const PwmBlink &config) {
+#if SOC_LEDC_SUPPORT_REF_TICK
+  const int8_t timer = LedcAllocator::getTimer(channel);
+  if(timer == ESPLED_NO_TIMER) return false;
+
+  if(ledc_timer_set(LEDC_MODE(channel), (ledc_timer_t)timer, config.divider, config.bits, LEDC_REF_TICK) != ESP_OK) return false;
+  ledc_timer_rst(LEDC_MODE(channel), (ledc_timer_t)timer);
+  if(ledc_set_duty(LEDC_MODE(channel), LEDC_CHANNEL(channel), config.duty) != ESP_OK) return false;
+  return ledc_update_duty(LEDC_MODE(channel), LEDC_CHANNEL(channel)) == ESP_OK;
+#else
+  return false;
+#endif
+}
+
+#else
+
+// ESP8266 PWM has no channels or timers to manage, no fade unit and
+// cannot go below 1Hz
+bool LedBackend::setupTimer(uint8_t, uint8_t, uint32_t, uint8_t) { return false; }
+bool LedBackend::bindTimer(uint8_t, uint8_t) { return false; }
+bool LedBackend::attach(uint8_t, uint8_t) { return false; }
+void LedBackend::write(uint8_t, uint32_t, uint8_t) { }
+bool LedBackend::hasFade() { return false; }
+bool LedBackend::fade(uint8_t, uint32_t, uint32_t) { return false; }
+void LedBackend::stopFade(uint8_t) { }
+bool LedBackend::blinkLimits(uint32_t &, uint8_t &) { return false; }
+bool LedBackend::blink(uint8_t, const PwmBlink &) { return false; }
+
+#endif
+
+#endif
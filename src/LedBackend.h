@@ -0,0 +1,66 @@
+/*
+  LedBackend.h
+
+  Calls into the PWM peripheral that go beyond writing a duty. Keeping
+  them here lets the logic built on top run against a stub on the host,
+  see extras/host/HostBackend.
+
+  On ESP32 fades are done by the LEDC fade unit and blinks by running a
+  timer at a very low frequency. Elsewhere both are reported as
+  unavailable and callers fall back to software.
+
+*/
+
+#ifndef ESPLED_BACKEND_H
+#define ESPLED_BACKEND_H
+
+#include <Arduino.h>
+
+// Timer settings that make a PWM channel blink on its own
+struct PwmBlink {
+  uint32_t divider;   // Source clock divider in Q8 fixed point
+  uint8_t bits;       // Duty resolution
+  uint32_t duty;      // High time in counts out of 2^bits
+};
+
+class LedBackend {
+public:
+
+  // Programs a timer in the channel's group to run at hz with bits resolution
+  static bool setupTimer(uint8_t channel, uint8_t timer, uint32_t hz, uint8_t bits);
+
+  // Switches a channel over to another timer of its group
+  static bool bindTimer(uint8_t channel, uint8_t timer);
+
+  // Routes a channel to a pin, running on the timer LedcAllocator gave it
+  static bool attach(uint8_t channel, uint8_t pin);
+
+  // Sets the duty of a channel, all bits set gives a fully on output
+  static void write(uint8_t channel, uint32_t duty, uint8_t bits);
+
+  // Returns true if duty can be ramped in hardware
+  static bool hasFade();
+
+  // Ramps a channel from its current duty to target over time_ms
+  // Returns false if the fade could not be started
+  static bool fade(uint8_t channel, uint32_t target, uint32_t time_ms);
+
+  // Halts a running fade, the channel holds its current duty
+  static void stopFade(uint8_t channel);
+
+  // Gets the clock and widest resolution available to PWM blinks
+  // Returns false if the PWM unit cannot blink on its own
+  static bool blinkLimits(uint32_t &clock_hz, uint8_t &maxBits);
+
+  // Works out timer settings for a blink, no hardware is touched
+  // Resolution is as high as the divider allows
+  // Returns false if the period cannot be reached or the duty rounds to always on / off
+  static bool blinkConfig(uint32_t period_ms, uint32_t high_ms, uint32_t clock_hz, uint8_t maxBits, PwmBlink &out);
+
+  // Programs a channel's timer and duty to blink
+  // The channel needs a timer to itself, see ESPLED_TIMER_EXCLUSIVE
+  static bool blink(uint8_t channel, const PwmBlink &config);
+
+};
+
+#endif
@@ -0,0 +1,36 @@
+/*
+  LedClock.h
+
+  Microsecond time base shared by the scheduler and the strategies. It is
+  64 bits wide so deadlines never wrap, and comes from esp_timer on ESP32
+  and micros64() on ESP8266 and the host.
+
+*/
+
+#ifndef ESPLED_CLOCK_H
+#define ESPLED_CLOCK_H
+
+#include <Arduino.h>
+
+#ifdef ESP32
+#include "esp_timer.h"
+#endif
+
+// Refresh rate to refresh period, us rather than ms so 60Hz stays 60Hz
+#define hzToUs(hz) (1000000UL/(hz))
+
+class LedClock {
+public:
+
+  // Returns the time in us since boot
+  static uint64_t now() {
+#ifdef ESP32
+    return esp_timer_get_time();
+#else
+    return micros64();
+#endif
+  }
+
+};
+
+#endif
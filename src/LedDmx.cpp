@@ -0,0 +1,165 @@
+#include "LedDmx.h"
+#include "ESPLed.h"
+
+// Art-Net fields
+#define ARTNET_OP_DMX         0x5000
+#define ARTNET_PROTOCOL       14
+
+// E1.31 fields
+#define E131_VECTOR_ROOT      0x00000004
+#define E131_VECTOR_FRAMING   0x00000002
+#define E131_VECTOR_DMP       0x02
+#define E131_ADDRESS_TYPE     0xA1
+#define E131_OPTION_PREVIEW   0x80
+#define E131_OPTION_STOPPED   0x40
+
+// Frames this far behind the last are taken as late rather than a restarted sender
+#define DMX_SEQUENCE_WINDOW   20
+
+static const uint8_t _artnetId[8] = { 'A', 'r', 't', '-', 'N', 'e', 't', 0 };
+static const uint8_t _e131Id[12] = { 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0 };
+
+static inline uint16_t _read16(const uint8_t *p) { return (uint16_t(p[0]) << 8) | p[1]; }
+static inline uint32_t _read32(const uint8_t *p) { return (uint32_t(_read16(p)) << 16) | _read16(p + 2); }
+
+
+
+LedDmx::LedDmx(LedGroup &group, uint16_t universe, uint16_t address) : _group(&group), _universe(universe) {
+  setAddress(address);
+}
+
+LedDmx &LedDmx::setUniverse(uint16_t universe) {
+  _universe = universe;
+  _sequenced = false;
+  return *this;
+}
+
+LedDmx &LedDmx::setAddress(uint16_t address) {
+  _address = constrain(address, 1, DMX_SLOTS);
+  _valid = false;
+  return *this;
+}
+
+
+
+/*
+  Checks the header of a packet and locates its slots
+  @params
+    Packet as received and its length, frame to fill in
+  @returns
+    true if the packet holds DMX slots, frame then points into packet
+*/
+bool LedDmx::parse(const uint8_t *packet, size_t length, DmxFrame &frame) {
+  if(packet == nullptr) return false;
+
+  // ArtDmx, little endian opcode and universe, big endian length
+  if(length >= ARTNET_HEADER_SIZE && memcmp(packet, _artnetId, sizeof(_artnetId)) == 0) {
+    if((packet[8] | (packet[9] << 8)) != ARTNET_OP_DMX) return false;
+    if(_read16(packet + 10) < ARTNET_PROTOCOL) return false;
+
+    const uint16_t count = _read16(packet + 16);
+    if(count == 0 || count > DMX_SLOTS || length < size_t(ARTNET_HEADER_SIZE + count)) return false;
+
+    frame.protocol = DMX_ARTNET;
+    frame.sequence = packet[12];
+    frame.universe = packet[14] | ((packet[15] & 0x7F) << 8);
+    frame.slots = packet + ARTNET_HEADER_SIZE;
+    frame.count = count;
+    return true;
+  }
+
+  // E1.31 data packet, root, framing and DMP layers at fixed offsets
+  if(length >= E131_HEADER_SIZE && _read16(packet) == 0x0010 && memcmp(packet + 4, _e131Id, sizeof(_e131Id)) == 0) {
+    if(_read32(packet + 18) != E131_VECTOR_ROOT || _read32(packet + 40) != E131_VECTOR_FRAMING) return false;
+    if(packet[117] != E131_VECTOR_DMP || packet[118] != E131_ADDRESS_TYPE) return false;
+    if(packet[112] & (E131_OPTION_PREVIEW | E131_OPTION_STOPPED)) return false;
+
+    // Property values are the start code followed by the slots, only start code 0 is dimmer data
+    const uint16_t values = _read16(packet + 123);
+    if(values < 2 || values > DMX_SLOTS + 1 || length < size_t(E131_HEADER_SIZE - 1 + values)) return false;
+    if(packet[125] != 0) return false;
+
+    frame.protocol = DMX_E131;
+    frame.sequence = packet[111];
+    frame.universe = _read16(packet + 113);
+    frame.slots = packet + E131_HEADER_SIZE;
+    frame.count = values - 1;
+    return true;
+  }
+
+  return false;
+}
+
+
+
+/*
+  Applies a packet addressed to this universe
+  @params
+    Packet as received and its length
+  @returns
+    true if the packet was a frame for this universe and was applied
+*/
+bool LedDmx::receive(const uint8_t *packet, size_t length) {
+  DmxFrame frame;
+  if(!parse(packet, length, frame) || !fits()) return false;
+  if(frame.universe != _universe || !_inOrder(frame)) return false;
+
+  apply(frame.slots, frame.count);
+  return true;
+}
+
+/*
+  Drops frames that arrive after a later one, as E1.31 requires
+  Art-Net sequence 0 means the sender does not number its frames
+*/
+bool LedDmx::_inOrder(const DmxFrame &frame) {
+  if(frame.protocol == DMX_ARTNET && frame.sequence == 0) {
+    _sequenced = false;
+    return true;
+  }
+
+  const int8_t ahead = frame.sequence - _sequence;
+  if(_sequenced && ahead <= 0 && ahead > -DMX_SEQUENCE_WINDOW) {
+    _outOfOrder++;
+    return false;
+  }
+
+  _sequence = frame.sequence;
+  _sequenced = true;
+  return true;
+}
+
+
+
+/*
+  Stages every patched slot that changed since the last frame and writes
+  the group, slots past the end of a short frame are left as they were
+  @params
+    Slots of a universe starting at DMX address 1, number of slots
+  @returns
+    Number of channels written, 0 if the patch runs past slot 512
+*/
+uint16_t LedDmx::apply(const uint8_t *slots, uint16_t count) {
+  if(!fits()) return 0;
+  _frames++;
+
+  const uint16_t first = _address - 1;
+  if(first >= count) return 0;
+
+  uint16_t patched = count - first;
+  if(patched > _group->size()) patched = _group->size();
+
+  const uint8_t *slot = slots + first;
+  for(uint16_t i = 0; i < patched; i++) {
+    const uint8_t value = slot[i];
+    if(_valid && value == _slots[i]) continue;
+
+    // Slots scale onto the level range, which the member's table maps onto its PWM value
+    _slots[i] = value;
+    _group->setLevel(i, (uint32_t(value) * LED_LEVEL_MAX + 127) / 255);
+  }
+
+  // Members past a short frame keep a stale slot, restage them all on the next full one
+  _valid = (patched == _group->size());
+  return _group->flush();
+}
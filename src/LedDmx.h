@@ -0,0 +1,115 @@
+/*
+  LedDmx.h
+
+  Drives a LedGroup from a DMX512 universe sent over the network by a
+  lighting controller, as Art-Net (ArtDmx) or E1.31 (sACN) data packets.
+  Packets are parsed in place, the slots are read straight out of the
+  receive buffer and never copied.
+
+  Consecutive slots from a DMX address are patched onto the members of a
+  group in order, one 8 bit slot per Led. Each frame is one pass over
+  the patched slots, only slots that differ from the previous frame are
+  put through the Led's brightness table and staged, and the group then
+  writes only the channels whose PWM value changed.
+
+    LedDmx dmx(group, 1, 10);       // Universe 1, members from slot 10
+    int length = udp.read(packet, sizeof(packet));
+    dmx.receive(packet, length);
+
+  One LedDmx patches at most ESPLED_GROUP_SIZE slots, the size of its
+  group. Build with -DESPLED_GROUP_SIZE=512 to patch a whole universe
+  from one group. A patch must end by slot 512, frames are not applied
+  while the address and group size run past it.
+
+  Frames are expected from a single source, E1.31 priorities and Art-Net
+  merging are not handled. Members should be in manual mode.
+
+*/
+
+#ifndef ESPLED_DMX_H
+#define ESPLED_DMX_H
+
+#include <Arduino.h>
+#include "LedGroup.h"
+
+#define DMX_SLOTS             512
+#define ARTNET_PORT           6454
+#define E131_PORT             5568
+
+// Largest data packet of either protocol, a receive buffer of this size holds any frame
+#define ARTNET_HEADER_SIZE    18
+#define E131_HEADER_SIZE      126
+#define DMX_PACKET_MAX        (E131_HEADER_SIZE + DMX_SLOTS)
+
+typedef enum DMX_PROTOCOLS {
+  DMX_NONE,
+  DMX_ARTNET,
+  DMX_E131
+} dmx_protocol_t;
+
+// One universe parsed out of a packet, slots point into the packet
+struct DmxFrame {
+  dmx_protocol_t protocol;
+  uint16_t universe;
+  uint8_t sequence;         // 0 from Art-Net senders that do not number frames
+  const uint8_t *slots;     // DMX address 1 is slots[0]
+  uint16_t count;
+};
+
+class LedDmx {
+public:
+
+  LedDmx(LedGroup &group, uint16_t universe = 0, uint16_t address = 1);
+
+  // Parses an ArtDmx or E1.31 data packet without copying it
+  // Returns false for any other packet, including E1.31 preview data
+  static bool parse(const uint8_t *packet, size_t length, DmxFrame &frame);
+
+  // Parses a packet and applies it if it is the next frame of this universe
+  // Returns true if it was applied
+  bool receive(const uint8_t *packet, size_t length);
+
+  // Applies the slots of a universe whatever its number or sequence
+  // Returns the number of channels written, 0 if the patch does not fit
+  uint16_t apply(const uint8_t *slots, uint16_t count);
+
+  // Sets the universe listened to, Art-Net 15 bit port address or E1.31 [1,63999]
+  LedDmx &setUniverse(uint16_t universe);
+
+  // Sets the DMX address of the first member [1,512]
+  LedDmx &setAddress(uint16_t address);
+
+  uint16_t getUniverse() { return _universe; }
+  uint16_t getAddress() { return _address; }
+
+  // Returns true if every member has a slot in the universe
+  bool fits() { return _address - 1 + _group->size() <= DMX_SLOTS; }
+
+  // Writes every patched slot on the next frame, ie after the Leds were changed elsewhere
+  void invalidate() { _valid = false; }
+
+  // Returns the number of frames applied
+  uint32_t getFrames() { return _frames; }
+
+  // Returns the number of frames for this universe dropped as late or duplicated
+  uint32_t getOutOfOrder() { return _outOfOrder; }
+
+protected:
+
+  LedGroup *_group;
+  uint16_t _universe;
+  uint16_t _address;
+  uint8_t _slots[ESPLED_GROUP_SIZE];    // Slots last applied to each member
+  bool _valid = false;                  // _slots match the members
+  bool _sequenced = false;              // _sequence holds a frame number
+  uint8_t _sequence = 0;
+  uint32_t _frames = 0;
+  uint32_t _outOfOrder = 0;
+
+  bool _inOrder(const DmxFrame &frame);
+
+private:
+
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "LedGroup.h"
+#include "ESPLed.h"
+
+
+bool LedGroup::add(Led &led) {
+  if(_count >= ESPLED_GROUP_SIZE) return false;
+
+  _leds[_count] = &led;
+  _dirty[_count >> 3] &= ~(1 << (_count & 7));
+  _count++;
+  return true;
+}
+
+
+
+/*
+  Functions to stage brightness for the next frame
+  Nothing is written until flush()
+  @params
+    Member index and / or brightness as a percent [0,100] or level
+  @returns
+    this
+*/
+LedGroup &LedGroup::set(uint16_t index, uint8_t percent) {
+  return setLevel(index, percentToLevel(percent > 100 ? 100 : percent));
+}
+
+LedGroup &LedGroup::setLevel(uint16_t index, uint16_t level) {
+  if(index >= _count) return *this;
+
+  Led *led = _leds[index];
+  level = constrain(level, led->getMinLevel(), led->getMaxLevel());
+  _stage(index, led->_mapToAnalog(level), level > led->getMinLevel());
+  return *this;
+}
+
+LedGroup &LedGroup::setAll(uint8_t percent) {
+  for(uint16_t i = 0; i < _count; i++) set(i, percent);
+  return *this;
+}
+
+LedGroup &LedGroup::setFrame(const uint8_t *percents) {
+  for(uint16_t i = 0; i < _count; i++) set(i, percents[i]);
+  return *this;
+}
+
+void LedGroup::_stage(uint16_t index, uint16_t duty, bool lit) {
+  const uint8_t bit = 1 << (index & 7);
+
+  if(lit) _lit[index >> 3] |= bit;
+  else _lit[index >> 3] &= ~bit;
+
+  // Only values that differ from what the channel holds are dirty
+  _pending[index] = duty;
+  if(duty != _leds[index]->_duty) _dirty[index >> 3] |= bit;
+  else _dirty[index >> 3] &= ~bit;
+}
+
+
+
+/*
+  Writes the staged frame
+  @params
+    void
+  @returns
+    Number of channels that were written
+*/
+uint16_t LedGroup::flush() {
+  uint16_t written = 0;
+
+  for(uint16_t byte = 0; byte < (_count + 7) / 8; byte++) {
+    uint8_t dirty = _dirty[byte];
+    const uint8_t lit = _lit[byte];
+    _dirty[byte] = 0;
+
+    // Bits past the last member have no Led behind them
+    if(byte == (_count >> 3)) dirty &= (1 << (_count & 7)) - 1;
+
+    // Skip eight clean channels at a time
+    for(uint16_t i = byte * 8; dirty; i++, dirty >>= 1) {
+      if(!(dirty & 1)) continue;
+      _leds[i]->_isOn = lit & (1 << (i & 7));
+      _leds[i]->_write(_pending[i]);
+      written++;
+    }
+  }
+
+  if(written) LedOutput::flushAll();
+  return written;
+}
@@ -0,0 +1,71 @@
+/*
+  LedGroup.h
+
+  Updates many Leds as one frame. New brightnesses are staged for every
+  member first and flush() then writes only the channels whose PWM value
+  actually changed, back to back.
+
+  Members should be in manual mode, an active pulse / blink keeps writing
+  to its Led on its own schedule.
+
+*/
+
+#ifndef ESPLED_GROUP_H
+#define ESPLED_GROUP_H
+
+#include <Arduino.h>
+
+// Maximum number of Leds in a group
+#ifndef ESPLED_GROUP_SIZE
+#define ESPLED_GROUP_SIZE 16
+#endif
+
+class Led;
+
+class LedGroup {
+public:
+
+  LedGroup() {}
+
+  // Adds a Led to the group, returns false if the group is full
+  bool add(Led &led);
+
+  // Returns the number of Leds in the group
+  uint16_t size() { return _count; }
+
+  // Returns a member Led
+  Led &get(uint16_t index) { return *_leds[index]; }
+
+  // Stages a brightness as a percent [0,100] for one member
+  LedGroup &set(uint16_t index, uint8_t percent);
+
+  // Stages a brightness level [0,LED_LEVEL_MAX] for one member
+  LedGroup &setLevel(uint16_t index, uint16_t level);
+
+  // Stages the same brightness for every member
+  LedGroup &setAll(uint8_t percent);
+
+  // Stages a whole frame, one percent per member in order
+  LedGroup &setFrame(const uint8_t *percents);
+
+  // Returns true if a member has a staged value not yet written
+  bool isDirty(uint16_t index) { return _dirty[index >> 3] & (1 << (index & 7)); }
+
+  // Writes every dirty member, returns the number of channels written
+  uint16_t flush();
+
+protected:
+
+  Led *_leds[ESPLED_GROUP_SIZE];
+  uint16_t _pending[ESPLED_GROUP_SIZE];   // Staged PWM values
+  uint8_t _dirty[(ESPLED_GROUP_SIZE + 7) / 8] = {};
+  uint8_t _lit[(ESPLED_GROUP_SIZE + 7) / 8] = {};    // Staged level is above the member's minimum
+  uint16_t _count = 0;
+
+  void _stage(uint16_t index, uint16_t duty, bool lit);
+
+private:
+
+};
+
+#endif
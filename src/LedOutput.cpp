@@ -0,0 +1,78 @@
+#include "LedOutput.h"
+#include "LedScheduler.h"
+
+
+LedOutput *LedOutput::_first = nullptr;
+
+LedOutput::LedOutput() {
+  _lock();
+  _next = _first;
+  _first = this;
+  _unlock();
+}
+
+LedOutput::~LedOutput() {
+  _lock();
+  LedOutput **link = &_first;
+  while(*link != nullptr && *link != this) link = &(*link)->_next;
+  if(*link == this) *link = _next;
+  _unlock();
+}
+
+
+
+/*
+  Functions that reach an output's hardware
+  The scheduler task already holds the lock when it calls them, the lock
+  is recursive so that costs nothing more
+  @params
+    Channel, duty out of 2^bits - 1 and its resolution
+  @returns
+    void
+*/
+void LedOutput::write(uint8_t channel, uint32_t duty, uint8_t bits) {
+  _lock();
+  _write(channel, duty, bits);
+  _unlock();
+}
+
+void LedOutput::flush() {
+  _lock();
+  _flush();
+  _unlock();
+}
+
+void LedOutput::flushAll() {
+  _lock();
+  for(LedOutput *output = _first; output != nullptr; output = output->_next) output->_flush();
+  _unlock();
+}
+
+void LedOutput::_lock() { LedScheduler::getInstance()._lockHeap(); }
+void LedOutput::_unlock() { LedScheduler::getInstance()._unlockHeap(); }
+
+
+
+/*
+  Recording output
+*/
+void RecordingOutput::_write(uint8_t channel, uint32_t duty, uint8_t bits) {
+  Entry &entry = _log[_count % ESPLED_RECORD_SIZE];
+  entry.channel = channel;
+  entry.bits = bits;
+  entry.duty = duty;
+  _count++;
+
+  if(channel < ESPLED_RECORD_CHANNELS) _values[channel] = duty;
+}
+
+const RecordingOutput::Entry &RecordingOutput::get(uint8_t index) {
+  const uint32_t kept = (_count < ESPLED_RECORD_SIZE) ? _count : ESPLED_RECORD_SIZE;
+  return _log[(_count - kept + index) % ESPLED_RECORD_SIZE];
+}
+
+void RecordingOutput::clear() {
+  _count = 0;
+  _flushes = 0;
+  memset(_values, 0, sizeof(_values));
+}
@@ -0,0 +1,110 @@
+/*
+  LedOutput.h
+
+  Where a Led's PWM values go when they are not written to a native pin.
+  An output may buffer writes, it is flushed at the end of every scheduler
+  pass and by LedGroup::flush(). Values written from loop() with on() /
+  off() reach an output that buffers once its flush() is called.
+
+  On ESP32 the scheduler task writes and flushes outputs while other tasks
+  may too, so write() and flush() hold the scheduler lock around the
+  output's own _write() / _flush(). A subclass never sees two calls at once.
+
+    Pca9685<TwoWire> expander(Wire);
+    Led led(expander, 3);
+    led.on();
+    expander.flush();
+
+*/
+
+#ifndef ESPLED_OUTPUT_H
+#define ESPLED_OUTPUT_H
+
+#include <Arduino.h>
+
+// Writes kept by a RecordingOutput
+#ifndef ESPLED_RECORD_SIZE
+#define ESPLED_RECORD_SIZE 32
+#endif
+
+// Channels a RecordingOutput tracks the last value of
+#define ESPLED_RECORD_CHANNELS 16
+
+class LedOutput {
+public:
+
+  LedOutput();
+  virtual ~LedOutput();
+
+  // Sets the duty of a channel, duty is out of 2^bits - 1
+  void write(uint8_t channel, uint32_t duty, uint8_t bits);
+
+  // Sends buffered writes
+  void flush();
+
+  // Flushes every output in existence
+  static void flushAll();
+
+protected:
+
+  // Implemented by each output, always called with the lock held
+  virtual void _write(uint8_t channel, uint32_t duty, uint8_t bits) = 0;
+  virtual void _flush() { }
+
+  // Serializes access to outputs and their list, no effect on ESP8266
+  static void _lock();
+  static void _unlock();
+
+  // Outputs form a linked list so they can all be flushed at once
+  LedOutput *_next = nullptr;
+  static LedOutput *_first;
+
+private:
+
+};
+
+
+
+/*
+  Keeps the latest writes in memory rather than driving anything
+  Useful to check what a Led would output without hardware
+*/
+class RecordingOutput : public LedOutput {
+public:
+
+  struct Entry {
+    uint8_t channel;
+    uint8_t bits;
+    uint16_t duty;
+  };
+
+  // Returns the number of writes since the last clear()
+  uint32_t count() { return _count; }
+
+  // Returns the number of flushes since the last clear()
+  uint32_t flushes() { return _flushes; }
+
+  // Returns a write, 0 is the oldest still kept
+  const Entry &get(uint8_t index);
+
+  // Returns the last duty written to a channel
+  uint16_t value(uint8_t channel) { return (channel < ESPLED_RECORD_CHANNELS) ? _values[channel] : 0; }
+
+  // Forgets every write
+  void clear();
+
+protected:
+
+  void _write(uint8_t channel, uint32_t duty, uint8_t bits);
+  void _flush() { _flushes++; }
+
+  Entry _log[ESPLED_RECORD_SIZE];
+  uint16_t _values[ESPLED_RECORD_CHANNELS] = {};
+  uint32_t _count = 0;
+  uint32_t _flushes = 0;
+
+private:
+
+};
+
+#endif
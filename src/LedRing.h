@@ -0,0 +1,77 @@
+/*
+  LedRing.h
+
+  Fixed size single producer / single consumer ring buffer. push() and
+  pop() never block or loop, each is a handful of loads and stores, so one
+  task or ISR can hand items to another without a lock. Only one context
+  may push and only one may pop at a time.
+
+  Indices run freely and are masked on use, so N must be a power of two
+  and every slot is usable.
+
+*/
+
+#ifndef ESPLED_RING_H
+#define ESPLED_RING_H
+
+#include <Arduino.h>
+#include <atomic>
+
+template<typename T, uint16_t N>
+class LedRing {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "LedRing size must be a power of two");
+public:
+
+  LedRing() {}
+
+  // Producer side, returns false if the ring is full
+  bool push(const T &item);
+
+  // Consumer side, returns false if the ring is empty
+  bool pop(T &item);
+
+  // Returns the number of items waiting, exact only from the producer or consumer
+  uint16_t size() { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+
+  bool isEmpty() { return size() == 0; }
+  bool isFull() { return size() >= N; }
+  uint16_t capacity() { return N; }
+
+protected:
+
+  T _items[N];
+  std::atomic<uint32_t> _head{0};     // Next slot written, only the producer stores it
+  std::atomic<uint32_t> _tail{0};     // Next slot read, only the consumer stores it
+
+private:
+
+};
+
+
+
+/*
+  The producer publishes an item by storing _head after the item, and the
+  consumer frees a slot by storing _tail after reading it. Each side only
+  needs to acquire the other's index.
+*/
+template<typename T, uint16_t N>
+bool LedRing<T, N>::push(const T &item) {
+  const uint32_t head = _head.load(std::memory_order_relaxed);
+  if(head - _tail.load(std::memory_order_acquire) >= N) return false;
+
+  _items[head & (N - 1)] = item;
+  _head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+template<typename T, uint16_t N>
+bool LedRing<T, N>::pop(T &item) {
+  const uint32_t tail = _tail.load(std::memory_order_relaxed);
+  if(tail == _head.load(std::memory_order_acquire)) return false;
+
+  item = _items[tail & (N - 1)];
+  _tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+#endif
@@ -0,0 +1,347 @@
+#include "LedScheduler.h"
+#include "ESPLed.h"
+
+
+LedScheduler &LedScheduler::getInstance() {
+  static LedScheduler instance;
+  return instance;
+}
+
+LedScheduler::LedScheduler() {
+#ifdef ESP32
+  _lock = xSemaphoreCreateRecursiveMutex();
+#endif
+}
+
+
+
+/*
+  Functions to add and remove interfaces from the schedule
+  @params
+    Pointer to the interface, delay before the first action in us
+  @returns
+    add() -> false if the scheduler is full
+*/
+bool LedScheduler::add(LedInterface *iface, uint32_t delay_us) {
+  _lockHeap();
+
+  if(iface->_heapIndex >= 0) _removeAt(iface->_heapIndex);
+  if(_count >= _capacity && !_grow((_capacity > ESPLED_SCHEDULER_MAX / 2) ? ESPLED_SCHEDULER_MAX : _capacity * 2)) {
+    _unlockHeap();
+    return false;
+  }
+
+  iface->_deadline_us = LedClock::now() + delay_us;
+  _push(iface);
+  const bool isNext = (_heap[0] == iface);
+
+#ifdef ESP32
+  _startTask();
+#endif
+
+  _unlockHeap();
+
+  // Only rearm if the earliest deadline changed
+  if(isNext) _arm();
+  return true;
+}
+
+void LedScheduler::remove(LedInterface *iface) {
+  _lockHeap();
+  if(iface->_heapIndex >= 0) _removeAt(iface->_heapIndex);
+  _unlockHeap();
+}
+
+bool LedScheduler::reserve(uint16_t capacity) {
+  _lockHeap();
+  const bool ok = (capacity <= _capacity) || _grow(capacity);
+  _unlockHeap();
+  return ok;
+}
+
+/*
+  Moves the heap into a larger allocation, the static slots are never freed
+  Must be called with the heap locked
+*/
+bool LedScheduler::_grow(uint16_t capacity) {
+  if(capacity <= _capacity || capacity > ESPLED_SCHEDULER_MAX) return false;
+
+  LedInterface **heap = (LedInterface **)malloc(capacity * sizeof(LedInterface *));
+  if(heap == nullptr) return false;
+
+  memcpy(heap, _heap, _count * sizeof(LedInterface *));
+  if(_heap != _fixed) free(_heap);
+  _heap = heap;
+  _capacity = capacity;
+  return true;
+}
+
+bool LedScheduler::contains(LedInterface *iface) {
+  return iface->_heapIndex >= 0;
+}
+
+
+
+/*
+  Runs the handler of every interface whose deadline has passed
+  Deadlines advance by the handler's wait time, not from now, so late
+  ticks do not accumulate drift
+  @params
+    void
+  @returns
+    Time in us until the next deadline, ESPLED_NO_DEADLINE if nothing is scheduled
+*/
+uint64_t LedScheduler::service() {
+  _lockHeap();
+  bool ran = false;
+
+#ifdef ESP32
+  // Frame boundary, settings changed by other tasks apply from here on
+  drain();
+#endif
+
+  while(_count > 0 && LedClock::now() >= _heap[0]->_deadline_us) {
+    LedInterface *iface = _heap[0];
+    _removeAt(0);
+    ran = true;
+
+#ifdef ESPLED_INSTRUMENT
+    const uint64_t start_us = LedClock::now();
+    const uint64_t wait = iface->_handle();
+    _record(iface, start_us - iface->_deadline_us, LedClock::now() - start_us, wait);
+#else
+    const uint64_t wait = iface->_handle();
+#endif
+
+    // Handler may have stopped its own interface
+    if(iface->isStarted() && iface->_heapIndex < 0) {
+      iface->_deadline_us += wait;
+      _push(iface);
+    }
+  }
+
+  // Outputs that buffer send the whole pass at once
+#ifdef ESPLED_INSTRUMENT
+  if(ran) {
+    const uint64_t start_us = LedClock::now();
+    LedOutput::flushAll();
+    LedStats::forKind(LED_STATS_OUTPUT).record(0, LedClock::now() - start_us, false);
+  }
+#else
+  if(ran) LedOutput::flushAll();
+#endif
+
+  uint64_t ret = ESPLED_NO_DEADLINE;
+  if(_count > 0) {
+    const uint64_t now = LedClock::now();
+    ret = (now < _heap[0]->_deadline_us) ? _heap[0]->_deadline_us - now : 0;
+  }
+
+  _unlockHeap();
+  return ret;
+}
+
+
+
+#ifdef ESPLED_INSTRUMENT
+/*
+  Tallies a tick against its kind of strategy and its Led
+  A tick misses when its next deadline has already passed as it returns,
+  the following tick then runs late or skips frames
+*/
+void LedScheduler::_record(LedInterface *iface, uint32_t late_us, uint32_t cost_us, uint64_t wait_us) {
+  const bool missed = iface->_deadline_us + wait_us < LedClock::now();
+
+  LedStats::forKind(iface->_statsKind()).record(late_us, cost_us, missed);
+  if(iface->_led != nullptr && iface->_led->_stats != nullptr) {
+    iface->_led->_stats->record(late_us, cost_us, missed);
+  }
+}
+#endif
+
+
+
+/*
+  Binary heap maintenance
+  Each interface stores its own heap index so removal is O(log n)
+*/
+void LedScheduler::_push(LedInterface *iface) {
+  _place(iface, _count++);
+  _siftUp(iface->_heapIndex);
+}
+
+void LedScheduler::_removeAt(uint16_t index) {
+  LedInterface *removed = _heap[index];
+  removed->_heapIndex = -1;
+
+  if(--_count == index) return;
+
+  // Fill the hole with the last element and restore ordering
+  LedInterface *moved = _heap[_count];
+  _place(moved, index);
+  _siftUp(index);
+  if(moved->_heapIndex == index) _siftDown(index);
+}
+
+void LedScheduler::_siftUp(uint16_t index) {
+  LedInterface *iface = _heap[index];
+  while(index > 0) {
+    const uint16_t parent = (index - 1) / 2;
+    if(iface->_deadline_us >= _heap[parent]->_deadline_us) break;
+    _place(_heap[parent], index);
+    index = parent;
+  }
+  _place(iface, index);
+}
+
+void LedScheduler::_siftDown(uint16_t index) {
+  LedInterface *iface = _heap[index];
+  while(true) {
+    uint16_t child = 2 * index + 1;
+    if(child >= _count) break;
+    if(child + 1 < _count && _heap[child + 1]->_deadline_us < _heap[child]->_deadline_us) child++;
+    if(_heap[child]->_deadline_us >= iface->_deadline_us) break;
+    _place(_heap[child], index);
+    index = child;
+  }
+  _place(iface, index);
+}
+
+void LedScheduler::_place(LedInterface *iface, uint16_t index) {
+  _heap[index] = iface;
+  iface->_heapIndex = index;
+}
+
+
+
+#ifdef ESP32
+
+void LedScheduler::begin() {
+  _lockHeap();
+  _startTask();
+  _unlockHeap();
+}
+
+// Must be called with the heap locked
+void LedScheduler::_startTask() {
+  if(_taskHandle != NULL) return;
+
+  xTaskCreate(
+    _taskWrap,      // Function
+    "Led Task",     // Name
+    2048,           // Stack size
+    (void*)this,    // Parameter
+    1,              // Task priority
+    &_taskHandle    // Task handle
+  );
+
+  // One shot timer that wakes the task between RTOS ticks
+  esp_timer_create_args_t args = {};
+  args.callback = _timerWrap;
+  args.arg = (void*)this;
+  args.name = "Led Timer";
+  esp_timer_create(&args, &_timer);
+}
+
+void LedScheduler::_arm() {
+  // Wake the task so it can recalculate its sleep time
+  if(_taskHandle != NULL) xTaskNotifyGive(_taskHandle);
+}
+
+void LedScheduler::_taskWrap(void *ptr) {
+  LedScheduler *self = (LedScheduler *)ptr;
+
+  while(true) {
+    const uint64_t wait = self->service();
+    if(wait == 0) continue;
+
+    // Sleep on the us timer rather than RTOS ticks, add() notifies early
+    esp_timer_stop(self->_timer);
+    if(wait != ESPLED_NO_DEADLINE) esp_timer_start_once(self->_timer, wait);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+
+void LedScheduler::_timerWrap(void *ptr) {
+  LedScheduler *self = (LedScheduler *)ptr;
+  xTaskNotifyGive(self->_taskHandle);
+}
+
+/*
+  Functions to hand setter calls to the scheduler task
+  Each ring has one producer at a time, the controlling task or whichever
+  ISR holds _isrMux, and their consumer side is serialized by the heap
+  lock, so any task holding the lock may drain them
+  @params
+    Led, command and its argument
+  @returns
+    post() -> false if the caller holds the lock and should apply the call itself
+*/
+bool LedScheduler::post(Led *led, uint8_t op, uintptr_t value, uint32_t arg) {
+  const LedCommand command = { led, op, value, arg };
+
+  if(xPortInIsrContext()) {
+    // An ISR can neither wait for the lock nor apply the call itself
+    // ISRs on both cores may post, the spinlock only covers the push
+    portENTER_CRITICAL_ISR(&_isrMux);
+    const bool queued = _isrCommands.push(command);
+    if(!queued) _dropped++;
+    portEXIT_CRITICAL_ISR(&_isrMux);
+
+    if(queued && _taskHandle != NULL) vTaskNotifyGiveFromISR(_taskHandle, NULL);
+    return true;
+  }
+
+  // Already inside a tick / drain, nothing can observe a partial update
+  if(xSemaphoreGetMutexHolder(_lock) == xTaskGetCurrentTaskHandle()) return false;
+
+  if(!_commands.push(command)) {
+    // Full, apply the backlog in this task rather than lose the call
+    drain();
+    _commands.push(command);
+  }
+  _arm();
+  return true;
+}
+
+void LedScheduler::drain() {
+  _lockHeap();
+  LedCommand command;
+  while(_commands.pop(command)) command.led->_apply(command.op, command.value, command.arg);
+  while(_isrCommands.pop(command)) command.led->_apply(command.op, command.value, command.arg);
+  _unlockHeap();
+}
+
+// Global constructors, ie of an output, run before FreeRTOS starts and need no lock
+void LedScheduler::_lockHeap() {
+  if(xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+}
+
+void LedScheduler::_unlockHeap() {
+  if(xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) xSemaphoreGiveRecursive(_lock);
+}
+
+#else
+
+void LedScheduler::_arm() {
+  _tick.detach();
+  if(_count == 0) return;
+
+  // Ticker counts in ms, wake at the first ms boundary past the deadline
+  const uint64_t now = LedClock::now();
+  const uint64_t deadline = _heap[0]->_deadline_us;
+  const uint64_t wait_ms = (now < deadline) ? (deadline - now + 999) / 1000 : 0;
+  _tick.once_ms((wait_ms > 0x7FFFFFFF) ? 0x7FFFFFFF : wait_ms, _tickerWrap, (void *)this);
+}
+
+void LedScheduler::_tickerWrap(void *ptr) {
+  LedScheduler *self = (LedScheduler *)ptr;
+  self->service();
+  self->_arm();
+}
+
+// Ticker callbacks never preempt loop() so no locking is needed
+void LedScheduler::_lockHeap() { }
+void LedScheduler::_unlockHeap() { }
+
+#endif
@@ -0,0 +1,167 @@
+/*
+  LedScheduler.h
+
+  Services every active LedInterface from a single timer.
+  Pending interfaces are kept in a binary min-heap keyed on the time of
+  their next action, so adding another Led costs one heap slot rather
+  than a new task / Ticker. The first ESPLED_SCHEDULER_SIZE slots are
+  static, past that the heap is reallocated at twice the size.
+
+  On ESP32 the scheduler runs in its own task. Setters called from other
+  tasks on a Led being animated are posted to a lock free command ring
+  and applied by the scheduler task before it next handles anything, so
+  the caller never blocks and a tick never sees half an update. Setters
+  called from an ISR are always posted, to a second ring, since an ISR
+  may neither take the scheduler lock nor touch the PWM peripheral.
+
+  Deadlines are kept in us from LedClock. ESP32 sleeps on a one shot
+  esp_timer so refresh rates of several hundred Hz are not rounded to
+  RTOS ticks. ESP8266 Tickers count in ms, there a tick may run up to 1ms
+  late but deadlines still advance in exact us steps.
+
+*/
+
+#ifndef ESPLED_SCHEDULER_H
+#define ESPLED_SCHEDULER_H
+
+#include <Arduino.h>
+#include "LedClock.h"
+
+#ifndef ESP32
+#include <Ticker.h>
+#else
+#include "LedRing.h"
+#include "esp_timer.h"
+#endif
+
+// Interfaces that may be active before the heap is moved to a larger allocation
+#ifndef ESPLED_SCHEDULER_SIZE
+#define ESPLED_SCHEDULER_SIZE 32
+#endif
+
+// Most interfaces that may ever be active at once
+#define ESPLED_SCHEDULER_MAX  0x7FFF
+
+// Setter calls that may wait for the scheduler task, a power of two
+#ifndef ESPLED_COMMAND_QUEUE
+#define ESPLED_COMMAND_QUEUE 32
+#endif
+
+// Setter calls from ISRs that may wait for the scheduler task, a power of two
+#ifndef ESPLED_ISR_QUEUE
+#define ESPLED_ISR_QUEUE 16
+#endif
+
+// Returned by service() when nothing is scheduled
+#define ESPLED_NO_DEADLINE UINT64_MAX
+
+class Led;
+class LedInterface;
+
+// A setter call waiting to be applied by the scheduler task
+struct LedCommand {
+  Led *led;
+  uint8_t op;
+  uintptr_t value;    // Wide enough for a pointer
+  uint32_t arg;
+};
+
+class LedScheduler {
+  friend class Led;
+  friend class LedOutput;
+public:
+
+  // Returns the scheduler shared by all Leds
+  static LedScheduler &getInstance();
+
+  // Schedules an interface to be handled after delay_us, the heap grows as needed
+  // Returns false if it could not grow
+  bool add(LedInterface *iface, uint32_t delay_us = 0);
+
+  // Makes room for capacity interfaces up front, ie before starting hundreds of Leds
+  // Returns false if the memory could not be allocated
+  bool reserve(uint16_t capacity);
+
+  // Removes an interface, no effect if it was not scheduled
+  void remove(LedInterface *iface);
+
+  // Handles every interface whose deadline has passed
+  // Returns the time in us until the next deadline
+  uint64_t service();
+
+  // Returns the number of scheduled interfaces
+  uint16_t size() { return _count; }
+
+  // Returns the number of interfaces that fit before the heap grows
+  uint16_t capacity() { return _capacity; }
+
+  // Returns true if the interface is scheduled
+  bool contains(LedInterface *iface);
+
+#ifdef ESP32
+  // Starts the scheduler task, which otherwise starts with the first animated Led
+  // Call it from setup() if ISRs change Leds before any is animated
+  void begin();
+
+  // Queues a setter call for the scheduler task
+  // Only one task may post, ISRs post to a ring of their own and never block
+  // Returns false if the caller already owns the scheduler and should apply it now
+  bool post(Led *led, uint8_t op, uintptr_t value, uint32_t arg = 0);
+
+  // Applies every queued command
+  void drain();
+
+  // Returns the number of commands an ISR posted to a full queue, which are lost
+  uint32_t getDropped() { return _dropped; }
+#endif
+
+protected:
+
+  LedScheduler();
+
+  // Heap starts in _fixed and moves to the heap allocator once it outgrows it
+  LedInterface *_fixed[ESPLED_SCHEDULER_SIZE];
+  LedInterface **_heap = _fixed;
+  uint16_t _capacity = ESPLED_SCHEDULER_SIZE;
+  uint16_t _count = 0;
+
+  bool _grow(uint16_t capacity);
+
+  void _push(LedInterface *iface);
+  void _removeAt(uint16_t index);
+  void _siftUp(uint16_t index);
+  void _siftDown(uint16_t index);
+  void _place(LedInterface *iface, uint16_t index);
+
+#ifdef ESPLED_INSTRUMENT
+  // Records the timing of one tick
+  void _record(LedInterface *iface, uint32_t late_us, uint32_t cost_us, uint64_t wait_us);
+#endif
+
+  // Arms the timer for the earliest deadline
+  void _arm();
+
+#ifdef ESP32
+  TaskHandle_t _taskHandle = NULL;
+  SemaphoreHandle_t _lock = NULL;
+  esp_timer_handle_t _timer = NULL;
+  LedRing<LedCommand, ESPLED_COMMAND_QUEUE> _commands;       // Pushed by the controlling task
+  LedRing<LedCommand, ESPLED_ISR_QUEUE> _isrCommands;        // Pushed by ISRs under _isrMux
+  portMUX_TYPE _isrMux = portMUX_INITIALIZER_UNLOCKED;
+  uint32_t _dropped = 0;
+  void _startTask();
+  static void _taskWrap(void*);
+  static void _timerWrap(void*);
+#else
+  Ticker _tick;
+  static void _tickerWrap(void*);
+#endif
+
+  void _lockHeap();
+  void _unlockHeap();
+
+private:
+
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "LedStats.h"
+
+#ifdef ESPLED_INSTRUMENT
+
+LedStats LedStats::_kinds[LED_STATS_KINDS];
+
+
+
+/*
+  Functions to tally ticks
+  @params
+    Lateness and handler time in us, true if the next deadline had passed
+  @returns
+    void
+*/
+void LedStats::record(uint32_t late_us, uint32_t cost_us, bool missed) {
+  _lateness[bucketOf(late_us)]++;
+  _cost[bucketOf(cost_us)]++;
+  _ticks++;
+  if(missed) _missed++;
+  if(late_us > _maxLateness_us) _maxLateness_us = late_us;
+  if(cost_us > _maxCost_us) _maxCost_us = cost_us;
+}
+
+void LedStats::reset() {
+  memset(_lateness, 0, sizeof(_lateness));
+  memset(_cost, 0, sizeof(_cost));
+  _ticks = 0;
+  _missed = 0;
+  _maxLateness_us = 0;
+  _maxCost_us = 0;
+}
+
+void LedStats::resetAll() {
+  for(uint8_t i = 0; i < LED_STATS_KINDS; i++) _kinds[i].reset();
+}
+
+uint8_t LedStats::bucketOf(uint32_t us) {
+  if(us == 0) return 0;
+  const uint8_t bucket = 32 - __builtin_clz(us);
+  return (bucket < ESPLED_STATS_BUCKETS) ? bucket : ESPLED_STATS_BUCKETS - 1;
+}
+
+uint32_t LedStats::_percentile(const uint32_t *histogram, uint8_t percent, uint32_t max_us) {
+  if(_ticks == 0) return 0;
+
+  // Smallest bucket holding the target tick, its bound is the answer
+  const uint32_t target = (uint64_t(_ticks) * percent + 99) / 100;
+  uint32_t seen = 0;
+  for(uint8_t i = 0; i < ESPLED_STATS_BUCKETS - 1; i++) {
+    seen += histogram[i];
+    if(seen >= target) return (bucketLimit(i) < max_us) ? bucketLimit(i) : max_us;
+  }
+  return max_us;
+}
+
+
+
+/*
+  Functions to dump stats
+  @params
+    Where to print and an optional heading
+  @returns
+    void
+*/
+const char *LedStats::kindName(uint8_t kind) {
+  switch(kind) {
+    case LED_STATS_PULSE:           return "Pulse";
+    case LED_STATS_HARDWARE_PULSE:  return "HardwarePulse";
+    case LED_STATS_BLINK:           return "Blink";
+    case LED_STATS_KEYFRAMES:       return "Keyframes";
+    case LED_STATS_SEQUENCE:        return "Sequence";
+    case LED_STATS_BANK:            return "PulseBank";
+    case LED_STATS_FADE:            return "Fade";
+    case LED_STATS_STREAM:          return "SampleStream";
+    case LED_STATS_OUTPUT:          return "Output flush";
+    default:                        return "Other";
+  }
+}
+
+void LedStats::print(Print &out, const char *name) {
+  if(_ticks == 0) return;
+
+  if(name != nullptr) {
+    out.print(name);
+    out.print(": ");
+  }
+  out.print(_ticks);
+  out.print(" ticks, ");
+  out.print(_missed);
+  out.print(" missed, late max ");
+  out.print(_maxLateness_us);
+  out.print("us p99 <");
+  out.print(latenessPercentile(99));
+  out.print("us, cost max ");
+  out.print(_maxCost_us);
+  out.print("us p99 <");
+  out.print(costPercentile(99));
+  out.println("us");
+
+  _printHistogram(out, "  late", _lateness);
+  _printHistogram(out, "  cost", _cost);
+}
+
+void LedStats::printAll(Print &out) {
+  for(uint8_t i = 0; i < LED_STATS_KINDS; i++) _kinds[i].print(out, kindName(i));
+}
+
+// One line of "<limit_us:count" pairs, empty buckets are skipped
+void LedStats::_printHistogram(Print &out, const char *label, const uint32_t *histogram) {
+  out.print(label);
+  for(uint8_t i = 0; i < ESPLED_STATS_BUCKETS; i++) {
+    if(histogram[i] == 0) continue;
+    out.print(' ');
+    out.print((i == ESPLED_STATS_BUCKETS - 1) ? ">=" : "<");
+    out.print((i == ESPLED_STATS_BUCKETS - 1) ? bucketLimit(i - 1) : bucketLimit(i));
+    out.print(':');
+    out.print(histogram[i]);
+  }
+  out.println();
+}
+
+#endif
@@ -0,0 +1,123 @@
+/*
+  LedStats.h
+
+  Opt-in timing instrumentation for the scheduler. Built with
+  ESPLED_INSTRUMENT defined, every tick records how late it ran, how long
+  its handler took and whether it returned with its next deadline already
+  passed. Ticks are tallied per kind of strategy, and per Led for Leds
+  given their own LedStats with setStats().
+
+  ESPLED_INSTRUMENT must be set for the whole build, ie as a -D build flag,
+  since it changes the layout of Led. Without it this header declares
+  nothing and the scheduler carries no extra code.
+
+    LedStats::printAll(Serial);
+
+  Times are in us and go into log2 buckets, bucket 0 holds 0us and bucket
+  n holds [2^(n-1), 2^n) us, the last bucket takes everything above.
+
+*/
+
+#ifndef ESPLED_STATS_H
+#define ESPLED_STATS_H
+
+#include <Arduino.h>
+
+#ifdef ESPLED_INSTRUMENT
+
+// Buckets in each histogram
+#ifndef ESPLED_STATS_BUCKETS
+#define ESPLED_STATS_BUCKETS 16
+#endif
+
+// What was ticked, one set of stats is kept for each
+typedef enum LED_STATS_KINDS {
+  LED_STATS_OTHER,
+  LED_STATS_PULSE,
+  LED_STATS_HARDWARE_PULSE,
+  LED_STATS_BLINK,
+  LED_STATS_KEYFRAMES,
+  LED_STATS_SEQUENCE,
+  LED_STATS_BANK,
+  LED_STATS_FADE,
+  LED_STATS_STREAM,
+  LED_STATS_OUTPUT,     // LedOutput flushes, cost only
+  LED_STATS_KINDS
+} led_stats_kind_t;
+
+// Declares which stats a strategy records into
+#define ESPLED_STATS_KIND(kind) uint8_t _statsKind() { return kind; }
+
+class LedStats {
+public:
+
+  LedStats() { reset(); }
+
+  // Tallies one tick
+  void record(uint32_t late_us, uint32_t cost_us, bool missed);
+
+  // Forgets every tick
+  void reset();
+
+  // Returns the number of ticks recorded
+  uint32_t ticks() { return _ticks; }
+
+  // Returns the number of ticks whose next deadline had passed by the time they returned
+  uint32_t missed() { return _missed; }
+
+  // Returns the worst lateness / handler time seen in us
+  uint32_t maxLateness() { return _maxLateness_us; }
+  uint32_t maxCost() { return _maxCost_us; }
+
+  // Returns the number of ticks in a bucket
+  uint32_t lateness(uint8_t bucket) { return (bucket < ESPLED_STATS_BUCKETS) ? _lateness[bucket] : 0; }
+  uint32_t cost(uint8_t bucket) { return (bucket < ESPLED_STATS_BUCKETS) ? _cost[bucket] : 0; }
+
+  // Returns an upper bound in us on the lateness / handler time of percent% of ticks
+  uint32_t latenessPercentile(uint8_t percent) { return _percentile(_lateness, percent, _maxLateness_us); }
+  uint32_t costPercentile(uint8_t percent) { return _percentile(_cost, percent, _maxCost_us); }
+
+  // Writes a summary and both histograms, skipped if nothing was recorded
+  void print(Print &out, const char *name = nullptr);
+
+  // Returns the stats kept for a kind of strategy
+  static LedStats &forKind(uint8_t kind) { return _kinds[(kind < LED_STATS_KINDS) ? kind : uint8_t(LED_STATS_OTHER)]; }
+
+  // Returns the name of a kind of strategy
+  static const char *kindName(uint8_t kind);
+
+  // Prints the stats of every kind that recorded a tick
+  static void printAll(Print &out);
+
+  // Resets the stats of every kind
+  static void resetAll();
+
+  // Returns the bucket a time falls in / the first time past a bucket
+  static uint8_t bucketOf(uint32_t us);
+  static uint32_t bucketLimit(uint8_t bucket) { return (bucket >= 31) ? 0xFFFFFFFF : uint32_t(1) << bucket; }
+
+protected:
+
+  uint32_t _lateness[ESPLED_STATS_BUCKETS];
+  uint32_t _cost[ESPLED_STATS_BUCKETS];
+  uint32_t _ticks;
+  uint32_t _missed;
+  uint32_t _maxLateness_us;
+  uint32_t _maxCost_us;
+
+  static LedStats _kinds[LED_STATS_KINDS];
+
+  uint32_t _percentile(const uint32_t *histogram, uint8_t percent, uint32_t max_us);
+  static void _printHistogram(Print &out, const char *label, const uint32_t *histogram);
+
+private:
+
+};
+
+#else
+
+#define ESPLED_STATS_KIND(kind)
+
+#endif
+
+#endif
@@ -0,0 +1,105 @@
+#include "LedcAllocator.h"
+#include "LedBackend.h"
+
+
+LedcAllocator::Timer LedcAllocator::_timers[ESPLED_LEDC_GROUPS][ESPLED_LEDC_TIMERS];
+uint8_t LedcAllocator::_channelTimers[ESPLED_LEDC_GROUPS * 8];
+
+
+
+/*
+  Functions to claim and free channels
+  @params
+    Channel, PWM frequency in Hz and resolution in bits
+  @returns
+    allocate() -> channel, ESPLED_NO_CHANNEL if none is left
+    claim() / retime() -> false if the channel or a timer is not available
+*/
+uint8_t LedcAllocator::allocate(uint32_t hz, uint8_t bits) {
+
+  // First pass only takes groups that can share a timer
+  for(uint8_t pass = 0; pass < 2; pass++) {
+    for(uint8_t group = 0; group < ESPLED_LEDC_GROUPS; group++) {
+      const int8_t timer = _findTimer(group, hz, bits);
+      if(timer == ESPLED_NO_TIMER) continue;
+      if(pass == 0 && _timers[group][timer].users == 0) continue;
+
+      for(uint8_t i = 0; i < ESPLED_LEDC_CHANNELS; i++) {
+        const uint8_t channel = group * 8 + i;
+        if(_channelTimers[channel] == 0) return claim(channel, hz, bits) ? channel : ESPLED_NO_CHANNEL;
+      }
+    }
+  }
+
+  return ESPLED_NO_CHANNEL;
+}
+
+bool LedcAllocator::claim(uint8_t channel, uint32_t hz, uint8_t bits) {
+  if(!isValid(channel) || _channelTimers[channel] != 0) return false;
+  return retime(channel, hz, bits);
+}
+
+bool LedcAllocator::retime(uint8_t channel, uint32_t hz, uint8_t bits) {
+  if(!isValid(channel)) return false;
+
+  const uint8_t group = channel / 8;
+  const int8_t current = getTimer(channel);
+  int8_t timer = _findTimer(group, hz, bits);
+
+  // Already on a matching timer
+  if(timer != ESPLED_NO_TIMER && timer == current) return true;
+
+  // A timer used by this channel alone is reprogrammed rather than swapped
+  if(current != ESPLED_NO_TIMER && _timers[group][current].users == 1
+    && (timer == ESPLED_NO_TIMER || _timers[group][timer].users == 0)) {
+    timer = current;
+  }
+  if(timer == ESPLED_NO_TIMER) return false;
+
+  Timer &t = _timers[group][timer];
+  if(t.users == 0 || timer == current) {
+    t.hz = hz;
+    t.bits = bits;
+
+    // Exclusive timers are programmed by whoever asked for them
+    if(hz != ESPLED_TIMER_EXCLUSIVE) LedBackend::setupTimer(channel, timer, hz, bits);
+  }
+
+  if(timer != current) {
+    if(current != ESPLED_NO_TIMER) _timers[group][current].users--;
+    t.users++;
+    _channelTimers[channel] = timer + 1;
+    LedBackend::bindTimer(channel, timer);
+  }
+
+  return true;
+}
+
+void LedcAllocator::release(uint8_t channel) {
+  const int8_t timer = getTimer(channel);
+  if(timer == ESPLED_NO_TIMER) return;
+
+  _timers[channel / 8][timer].users--;
+  _channelTimers[channel] = 0;
+}
+
+int8_t LedcAllocator::getTimer(uint8_t channel) {
+  if(!isValid(channel)) return ESPLED_NO_TIMER;
+  return int8_t(_channelTimers[channel]) - 1;
+}
+
+int8_t LedcAllocator::_findTimer(uint8_t group, uint32_t hz, uint8_t bits) {
+  int8_t ret = ESPLED_NO_TIMER;
+
+  for(uint8_t i = 0; i < ESPLED_LEDC_TIMERS; i++) {
+    const Timer &t = _timers[group][i];
+    if(t.users == 0) {
+      if(ret == ESPLED_NO_TIMER) ret = i;
+    }
+    else if(hz != ESPLED_TIMER_EXCLUSIVE && t.hz == hz && t.bits == bits) {
+      return i;
+    }
+  }
+
+  return ret;
+}
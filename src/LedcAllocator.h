@@ -0,0 +1,93 @@
+/*
+  LedcAllocator.h
+
+  Hands out ESP32 LEDC channels and shares the timers behind them.
+  Channels are numbered like the Arduino core, group * 8 + index, and a
+  channel can only use one of the 4 timers of its own group. Leds asking
+  for the same frequency and resolution share a timer, so all 16 channels
+  can be used while only as many timers are spent as there are distinct
+  settings.
+
+  Bookkeeping is plain C++ so it also runs in the host build. Hardware is
+  only touched through LedBackend.
+
+*/
+
+#ifndef ESPLED_LEDC_ALLOCATOR_H
+#define ESPLED_LEDC_ALLOCATOR_H
+
+#include <Arduino.h>
+
+#ifdef ESP32
+#include "soc/soc_caps.h"
+#if SOC_LEDC_SUPPORT_HS_MODE
+#define ESPLED_LEDC_GROUPS 2
+#else
+#define ESPLED_LEDC_GROUPS 1
+#endif
+#define ESPLED_LEDC_CHANNELS SOC_LEDC_CHANNEL_NUM
+#else
+// Laid out like the original ESP32 so the host build can exercise it
+#define ESPLED_LEDC_GROUPS 2
+#define ESPLED_LEDC_CHANNELS 8
+#endif
+
+// Timers in each group
+#define ESPLED_LEDC_TIMERS 4
+
+// Returned when no channel / timer is left
+#define ESPLED_NO_CHANNEL 0xFF
+#define ESPLED_NO_TIMER   -1
+
+// Frequency asking for a timer of its own, ie for a hardware blink
+#define ESPLED_TIMER_EXCLUSIVE 0
+
+class LedcAllocator {
+public:
+
+  // Claims any free channel on a timer running at hz with bits resolution
+  // Returns the channel, ESPLED_NO_CHANNEL if channels or timers ran out
+  static uint8_t allocate(uint32_t hz, uint8_t bits);
+
+  // Claims a particular channel, returns false if it is taken or no timer is left
+  static bool claim(uint8_t channel, uint32_t hz, uint8_t bits);
+
+  // Moves a claimed channel onto a timer running at hz with bits resolution
+  // Returns false and leaves the channel where it was if no timer is left
+  static bool retime(uint8_t channel, uint32_t hz, uint8_t bits);
+
+  // Frees a channel, and its timer once no other channel uses it
+  static void release(uint8_t channel);
+
+  // Returns the timer a channel runs on, ESPLED_NO_TIMER if it is free
+  static int8_t getTimer(uint8_t channel);
+
+  // Returns the number of channels sharing a timer
+  static uint8_t getUsers(uint8_t group, uint8_t timer) { return _timers[group][timer].users; }
+
+  // Returns true if the channel number exists on this chip
+  static bool isValid(uint8_t channel) {
+    return channel / 8 < ESPLED_LEDC_GROUPS && channel % 8 < ESPLED_LEDC_CHANNELS;
+  }
+
+protected:
+
+  struct Timer {
+    uint32_t hz;
+    uint8_t bits;
+    uint8_t users;
+  };
+
+  static Timer _timers[ESPLED_LEDC_GROUPS][ESPLED_LEDC_TIMERS];
+
+  // Timer + 1 for every channel, 0 while the channel is free
+  static uint8_t _channelTimers[ESPLED_LEDC_GROUPS * 8];
+
+  // Returns a timer in group already running at hz / bits, or a free one
+  static int8_t _findTimer(uint8_t group, uint32_t hz, uint8_t bits);
+
+private:
+
+};
+
+#endif
@@ -0,0 +1,188 @@
+/*
+  Pca9685.h
+
+  Output for a PCA9685 style 16 channel 12 bit I2C PWM expander. Writes
+  only update a shadow copy of the channels, flush() then sends every
+  channel that changed in a single auto increment transaction covering
+  the first through the last dirty channel.
+
+  Bus is anything shaped like TwoWire: beginTransmission(), write() and
+  endTransmission(). A full frame is 65 bytes, within the 128 byte buffer
+  of the ESP8266 and ESP32 Wire libraries. A frame the chip does not
+  acknowledge leaves its channels dirty, so the next flush sends them again.
+
+  Every bus transaction is made with the LedOutput lock held, so on ESP32
+  the scheduler task and other tasks never share the bus mid transaction.
+
+*/
+
+#ifndef ESPLED_PCA9685_H
+#define ESPLED_PCA9685_H
+
+#include <Arduino.h>
+#include "LedOutput.h"
+
+#define PCA9685_ADDRESS   0x40
+#define PCA9685_CHANNELS  16
+#define PCA9685_BITS      12
+
+// Registers
+#define PCA9685_MODE1     0x00
+#define PCA9685_MODE2     0x01
+#define PCA9685_LED0      0x06
+#define PCA9685_PRESCALE  0xFE
+
+// Register bits
+#define PCA9685_RESTART   0x80
+#define PCA9685_AI        0x20
+#define PCA9685_SLEEP     0x10
+#define PCA9685_ALLCALL   0x01
+#define PCA9685_OUTDRV    0x04
+#define PCA9685_FULL      0x10    // Full on / off bit in the high byte
+
+template<typename Bus>
+class Pca9685 : public LedOutput {
+public:
+
+  Pca9685(Bus &bus, uint8_t address = PCA9685_ADDRESS) : _bus(&bus), _address(address) { }
+
+  // Wakes the chip with register auto increment and totem pole outputs
+  // Returns false if the chip did not acknowledge
+  bool begin(unsigned long hz = 1000);
+
+  // Sets the PWM frequency of every channel, [24,1526] Hz
+  bool setFrequency(unsigned long hz);
+
+  // Returns true if a channel changed since the last successful flush()
+  bool isDirty(uint8_t channel) { return _dirty & (1 << channel); }
+
+  // Returns the number of frames flush() has tried to send
+  uint32_t getTransactions() { return _transactions; }
+
+  // Returns the number of frames the chip did not acknowledge
+  uint32_t getErrors() { return _errors; }
+
+protected:
+
+  Bus *_bus;
+  uint8_t _address;
+  uint16_t _duty[PCA9685_CHANNELS] = {};   // 12 bit values, 4096 is full on
+  uint16_t _dirty = 0;
+  uint32_t _transactions = 0;
+  uint32_t _errors = 0;
+
+  // Stores the duty of a channel until the next flush()
+  void _write(uint8_t channel, uint32_t duty, uint8_t bits);
+
+  // Sends all changed channels in one transaction
+  void _flush();
+
+  bool _writeRegister(uint8_t reg, uint8_t value);
+
+private:
+
+};
+
+
+
+template<typename Bus>
+bool Pca9685<Bus>::begin(unsigned long hz) {
+  _lock();
+  const bool ok = _writeRegister(PCA9685_MODE2, PCA9685_OUTDRV) && setFrequency(hz);
+
+  // Every channel is unknown after a reset, send them all on the next flush
+  if(ok) _dirty = 0xFFFF;
+  _unlock();
+  return ok;
+}
+
+template<typename Bus>
+bool Pca9685<Bus>::setFrequency(unsigned long hz) {
+  if(hz == 0) return false;
+
+  // Prescale = round(25MHz / (4096 * hz)) - 1, only writable while asleep
+  long prescale = (25000000L + 2048L * hz) / (4096L * hz) - 1;
+  prescale = constrain(prescale, 3, 255);
+
+  _lock();
+  bool ok = _writeRegister(PCA9685_MODE1, PCA9685_AI | PCA9685_ALLCALL | PCA9685_SLEEP)
+    && _writeRegister(PCA9685_PRESCALE, prescale)
+    && _writeRegister(PCA9685_MODE1, PCA9685_AI | PCA9685_ALLCALL);
+
+  // Oscillator needs 500us to settle before PWM restarts
+  if(ok) {
+    delayMicroseconds(500);
+    ok = _writeRegister(PCA9685_MODE1, PCA9685_RESTART | PCA9685_AI | PCA9685_ALLCALL);
+  }
+  _unlock();
+  return ok;
+}
+
+
+
+/*
+  Functions to buffer and send channel values
+  @params
+    Channel [0,15], duty out of 2^bits - 1 and its resolution
+  @returns
+    void
+*/
+template<typename Bus>
+void Pca9685<Bus>::_write(uint8_t channel, uint32_t duty, uint8_t bits) {
+  if(channel >= PCA9685_CHANNELS || bits == 0) return;
+
+  // Rescale onto 12 bits, a full duty maps onto the full on bit
+  const uint32_t max = (uint32_t(1) << bits) - 1;
+  uint16_t value;
+  if(duty >= max) value = 1 << PCA9685_BITS;
+  else if(bits >= PCA9685_BITS) value = duty >> (bits - PCA9685_BITS);
+  else value = (duty << PCA9685_BITS) / (max + 1);
+
+  if(value == _duty[channel]) return;
+  _duty[channel] = value;
+  _dirty |= 1 << channel;
+}
+
+template<typename Bus>
+void Pca9685<Bus>::_flush() {
+  if(_dirty == 0) return;
+
+  uint8_t first = 0;
+  while(!(_dirty & (1 << first))) first++;
+  uint8_t last = PCA9685_CHANNELS - 1;
+  while(!(_dirty & (1 << last))) last--;
+
+  // Clean channels between dirty ones are resent rather than split the frame
+  _bus->beginTransmission(_address);
+  _bus->write(uint8_t(PCA9685_LED0 + 4 * first));
+  for(uint8_t i = first; i <= last; i++) {
+    const uint16_t value = _duty[i];
+    uint8_t regs[4] = { 0, 0, 0, 0 };     // ON_L, ON_H, OFF_L, OFF_H
+
+    if(value >= (1 << PCA9685_BITS)) regs[1] = PCA9685_FULL;
+    else if(value == 0) regs[3] = PCA9685_FULL;
+    else {
+      regs[2] = value & 0xFF;
+      regs[3] = value >> 8;
+    }
+    _bus->write(regs, 4);
+  }
+  _transactions++;
+
+  // Keep the channels dirty so the next flush sends them again
+  if(_bus->endTransmission() != 0) {
+    _errors++;
+    return;
+  }
+  _dirty = 0;
+}
+
+template<typename Bus>
+bool Pca9685<Bus>::_writeRegister(uint8_t reg, uint8_t value) {
+  _bus->beginTransmission(_address);
+  _bus->write(reg);
+  _bus->write(value);
+  return _bus->endTransmission() == 0;
+}
+
+#endif
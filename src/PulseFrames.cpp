@@ -0,0 +1,91 @@
+#include "PulseFrames.h"
+
+
+PulseFrames PulseFrames::_pool[ESPLED_PULSE_CACHES];
+
+/*
+  Pool is shared between the scheduler and application tasks on ESP32
+*/
+#ifdef ESP32
+static portMUX_TYPE _poolMux = portMUX_INITIALIZER_UNLOCKED;
+#define POOL_LOCK()   portENTER_CRITICAL(&_poolMux)
+#define POOL_UNLOCK() portEXIT_CRITICAL(&_poolMux)
+#else
+#define POOL_LOCK()
+#define POOL_UNLOCK()
+#endif
+
+
+
+/*
+  Functions to look up and claim cached waveforms
+  @params
+    Parameters the waveform was rendered with
+  @returns
+    Pointer to the slot, nullptr if not found / pool full
+*/
+PulseFrames *PulseFrames::find(const PulseFramesKey &key) {
+  PulseFrames *ret = nullptr;
+
+  POOL_LOCK();
+  for(uint8_t i = 0; i < ESPLED_PULSE_CACHES; i++) {
+    if(_pool[i]._refs > 0 && _pool[i]._key == key) {
+      ret = &_pool[i];
+      ret->_refs++;
+      break;
+    }
+  }
+  POOL_UNLOCK();
+
+  return ret;
+}
+
+PulseFrames *PulseFrames::allocate(const PulseFramesKey &key) {
+  if(key.count == 0) return nullptr;
+
+  PulseFrames *ret = nullptr;
+
+  POOL_LOCK();
+  for(uint8_t i = 0; i < ESPLED_PULSE_CACHES; i++) {
+    if(_pool[i]._refs == 0) {
+      ret = &_pool[i];
+      ret->_refs = 1;
+      ret->_key = key;
+      ret->_runs = 0;
+      break;
+    }
+  }
+  POOL_UNLOCK();
+
+  return ret;
+}
+
+void PulseFrames::release(PulseFrames *frames) {
+  if(frames == nullptr) return;
+
+  POOL_LOCK();
+  if(frames->_refs > 0) frames->_refs--;
+  POOL_UNLOCK();
+}
+
+
+
+/*
+  Adds a frame to the slot, extending the last run if the value repeats
+  @params
+    PWM value of the frame
+  @returns
+    false if ESPLED_PULSE_RUNS would be exceeded
+*/
+bool PulseFrames::append(uint16_t duty) {
+  if(_runs > 0 && run[_runs - 1].duty == duty && run[_runs - 1].frames < 0xFFFF) {
+    run[_runs - 1].frames++;
+    return true;
+  }
+  if(_runs >= ESPLED_PULSE_RUNS) return false;
+
+  run[_runs].duty = duty;
+  run[_runs].frames = 1;
+  _runs++;
+  return true;
+}
@@ -0,0 +1,88 @@
+/*
+  PulseFrames.h
+
+  Cache of pre-rendered Pulse waveforms. One full period of final PWM
+  values is rendered into a slot from a fixed pool, and Leds pulsing with
+  identical parameters share the same slot through a reference count.
+
+  Frames are stored run length encoded, so each run gives both the value
+  to write and how many refreshes pass before the output next changes.
+
+*/
+
+#ifndef ESPLED_PULSE_FRAMES_H
+#define ESPLED_PULSE_FRAMES_H
+
+#include <Arduino.h>
+#include "BrightnessLut.h"
+
+// Number of distinct waveforms that can be cached at once
+#ifndef ESPLED_PULSE_CACHES
+#define ESPLED_PULSE_CACHES 4
+#endif
+
+// Most distinct output changes a cached period may contain
+// Waveforms with more runs are computed on every tick instead
+#ifndef ESPLED_PULSE_RUNS
+#define ESPLED_PULSE_RUNS 128
+#endif
+
+// One PWM value and the number of refreshes it is held for
+struct PulseRun {
+  uint16_t duty;
+  uint16_t frames;
+};
+
+// Everything that changes the rendered output of a Pulse
+struct PulseFramesKey {
+  uint16_t count;   // Frames per period
+  uint16_t min;     // Brightness range as a level
+  uint16_t max;
+  uint8_t style;    // led_style_t of the Led
+  const BrightnessLut *lut;
+
+  bool operator==(const PulseFramesKey &other) const {
+    return count == other.count && min == other.min && max == other.max
+      && style == other.style && lut == other.lut;
+  }
+};
+
+class PulseFrames {
+public:
+
+  // Returns a cached waveform matching key with its reference taken
+  // Returns nullptr if none matches
+  static PulseFrames *find(const PulseFramesKey &key);
+
+  // Claims an unused slot for key, frames must then be rendered by the caller
+  // Returns nullptr if the pool is exhausted
+  static PulseFrames *allocate(const PulseFramesKey &key);
+
+  // Drops a reference, the slot is reused once no Led holds it
+  static void release(PulseFrames *frames);
+
+  // Appends one frame to the end of the period
+  // Returns false if the slot has run out of runs
+  bool append(uint16_t duty);
+
+  const PulseFramesKey &getKey() { return _key; }
+  uint16_t getCount() { return _key.count; }
+  uint16_t getRuns() { return _runs; }
+  uint8_t getReferences() { return _refs; }
+
+  // Runs making up one period, getRuns() long
+  PulseRun run[ESPLED_PULSE_RUNS];
+
+protected:
+
+  PulseFramesKey _key;
+  uint16_t _runs = 0;
+  uint8_t _refs = 0;
+
+  static PulseFrames _pool[ESPLED_PULSE_CACHES];
+
+private:
+
+};
+
+#endif
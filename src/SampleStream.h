@@ -0,0 +1,41 @@
+/*
+  SampleStream.h
+
+  Lets a Led follow an external signal such as a sensor reading or an
+  audio envelope. A producer pushes brightness samples into a LedSamples
+  ring from any one task or ISR, at whatever rate it has them, and the
+  Led's stream strategy reads them back at its own refresh rate. The
+  producer never touches the PWM unit.
+
+    LedSamples samples;
+    led.stream(samples, STREAM_PEAK, 200).start();
+    ...
+    samples.push(envelope);   // [0,LED_LEVEL_MAX]
+
+  Samples are relative to the Led's brightness range, like keyframes.
+  When the ring is full push() fails and the sample is lost, so the ring
+  only needs to cover one refresh worth of samples.
+
+*/
+
+#ifndef ESPLED_SAMPLE_STREAM_H
+#define ESPLED_SAMPLE_STREAM_H
+
+#include <Arduino.h>
+#include "LedRing.h"
+
+// Samples a LedSamples ring holds, a power of two
+#ifndef ESPLED_STREAM_SAMPLES
+#define ESPLED_STREAM_SAMPLES 32
+#endif
+
+// How the samples that arrived since the last refresh become one level
+typedef enum STREAM_MODES {
+  STREAM_LATEST,    // Newest sample, older ones are dropped
+  STREAM_AVERAGE,   // Mean of the samples, resampling by averaging
+  STREAM_PEAK       // Highest sample, held and decayed by the smoothing
+} stream_mode_t;
+
+typedef LedRing<uint16_t, ESPLED_STREAM_SAMPLES> LedSamples;
+
+#endif
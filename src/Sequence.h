@@ -0,0 +1,57 @@
+/*
+  Sequence.h
+
+  Byte code for blink patterns such as fault codes or Morse. Patterns are
+  read straight from flash one opcode at a time, nothing is copied to RAM.
+
+  "3 short, 2 long, pause" repeated forever, ie
+
+    const uint8_t fault32[] PROGMEM = {
+      SEQ_REPEAT(3), SEQ_ON, SEQ_WAIT(200), SEQ_OFF, SEQ_WAIT(200), SEQ_NEXT,
+      SEQ_REPEAT(2), SEQ_ON, SEQ_WAIT(600), SEQ_OFF, SEQ_WAIT(200), SEQ_NEXT,
+      SEQ_WAIT(1500),
+      SEQ_LOOP
+    };
+    led.sequence(fault32).start();
+
+*/
+
+#ifndef ESPLED_SEQUENCE_H
+#define ESPLED_SEQUENCE_H
+
+#include <Arduino.h>
+
+// Deepest nesting of SEQ_REPEAT blocks
+#ifndef ESPLED_SEQUENCE_DEPTH
+#define ESPLED_SEQUENCE_DEPTH 4
+#endif
+
+// Most opcodes run in one tick before the sequence yields for 1ms
+// Guards against patterns that loop without ever waiting
+#ifndef ESPLED_SEQUENCE_STEPS
+#define ESPLED_SEQUENCE_STEPS 32
+#endif
+
+// Opcodes, operands follow the opcode byte
+typedef enum SEQUENCE_OPCODES {
+  SEQ_OP_END,       // Turns the Led off and stops
+  SEQ_OP_ON,        // Turns the Led on to max brightness
+  SEQ_OP_OFF,       // Turns the Led off
+  SEQ_OP_LEVEL,     // 1 byte percent, turns the Led on to that brightness
+  SEQ_OP_WAIT,      // 2 bytes ms big endian, holds the output
+  SEQ_OP_REPEAT,    // 1 byte count, plays up to the matching SEQ_NEXT count times
+  SEQ_OP_NEXT,      // Closes a SEQ_REPEAT block
+  SEQ_OP_LOOP       // Jumps back to the start of the pattern
+} sequence_opcode_t;
+
+// Helpers that expand to the bytes of each instruction
+#define SEQ_END           SEQ_OP_END
+#define SEQ_ON            SEQ_OP_ON
+#define SEQ_OFF           SEQ_OP_OFF
+#define SEQ_LEVEL(pct)    SEQ_OP_LEVEL, (uint8_t)(pct)
+#define SEQ_WAIT(ms)      SEQ_OP_WAIT, (uint8_t)((ms) >> 8), (uint8_t)(ms)
+#define SEQ_REPEAT(count) SEQ_OP_REPEAT, (uint8_t)(count)
+#define SEQ_NEXT          SEQ_OP_NEXT
+#define SEQ_LOOP          SEQ_OP_LOOP
+
+#endif